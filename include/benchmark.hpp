@@ -0,0 +1,37 @@
+#pragma once
+#include "graph.hpp"
+#include <functional>
+#include <string>
+#include <vector>
+
+// Random sources used when the schema lists none
+#define BENCHMARK_DEFAULT_SOURCES 64
+
+// Settings of the benchmark mode
+struct BenchmarkConfig {
+  std::vector<std::string> engines; // Implementations to compare
+  uint32_t num_sources; // Random sources to use (0: the schema's sources)
+  uint32_t warmup;      // Untimed runs per source
+  uint32_t trials;      // Timed runs per source
+  uint64_t seed;        // Seed of the random source selection
+  bool check;           // Check the first result of each source
+  std::string report;   // .csv or .json file (empty for no report)
+};
+
+// Builds the engine called name on a graph
+template <typename eidType>
+using EngineFactory = std::function<BFS_Impl<eidType> *(
+    Graph<eidType> *graph, const std::string &name)>;
+
+// Pick num_sources distinct random vertices with at least one neighbor
+template <typename eidType>
+std::vector<vidType> random_sources(const Graph<eidType> *graph,
+                                    uint32_t num_sources, uint64_t seed);
+
+// Run every engine from every source and report time and GTEPS per engine.
+// Traversed edges are the edges of the vertices reached from the source.
+// Returns a non-zero value if a check fails
+template <typename eidType>
+int run_benchmark(Graph<eidType> *graph,
+                  const EngineFactory<eidType> &make_engine,
+                  const BenchmarkConfig &config);
@@ -0,0 +1,25 @@
+#pragma once
+#include "graph.hpp"
+#include <string>
+#include <vector>
+
+// Sources timed by calibrate_thresholds if the schema lists none
+#define CALIBRATE_SOURCES 4
+
+// Name under which the thresholds of an engine are stored, or nullptr if the
+// engine does not switch direction
+template <typename eidType>
+const char *thresholds_key(const BFS_Impl<eidType> *bfs);
+
+// Apply the thresholds stored in the tuning file of the schema, if they were
+// calibrated for this engine on this machine. Returns true if found
+template <typename eidType>
+bool load_thresholds(BFS_Impl<eidType> *bfs, const std::string &schema_path);
+
+// Search the thresholds that minimize the BFS time from the given sources:
+// alpha first, then beta with the best alpha. The engine keeps the best pair,
+// which is also stored in the tuning file of the schema
+template <typename eidType>
+void calibrate_thresholds(BFS_Impl<eidType> *bfs,
+                          const std::string &schema_path,
+                          const std::vector<vidType> &sources);
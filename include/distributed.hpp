@@ -0,0 +1,57 @@
+#pragma once
+#ifdef BFS_MPI
+#include "graph.hpp"
+#include <mpi.h>
+#include <vector>
+
+// Distributed-memory BFS over MPI with a 1D partition. Each rank owns a range
+// of vertices, balanced by vertices plus edges, and keeps only their rows of
+// rowptr and col. Top-down steps send the remote vertices they discover to
+// their owners with an all-to-all exchange. Bottom-up steps combine the
+// frontiers of all ranks in a bitmap with an all-reduce, then each rank scans
+// its own unvisited vertices. Every rank ends with the whole distance array.
+// MPI is called only outside parallel regions (MPI_THREAD_FUNNELED).
+// If the graph was loaded with LoadMode::HEADER the rows are read from the
+// binary dataset. Besides its rows a rank holds O(N) memory: the frontier
+// bitmap and the gathered distances
+template <typename eidType> class Distributed : public BFS_Impl<eidType> {
+private:
+  MPI_Comm comm;
+  int rank;
+  int num_ranks;
+  std::vector<vidType> bounds; // First vertex of each rank, then N
+  std::vector<int> range_counts, range_displs; // Of each rank, for MPI
+  vidType first;                // First vertex of this rank
+  vidType count;                // Vertices of this rank
+  eidType *rowptr;              // Rows of the local vertices, from 0
+  vidType *col;                 // Their neighbors, as global IDs
+  weight_type *depth;           // Distances of the local vertices
+  uint64_t words;
+  uint64_t *frontier_bits;      // Frontier of all ranks, for bottom-up steps
+  Frontier<vidType> this_frontier; // Local indices
+  Frontier<vidType> next_frontier;
+  std::vector<Frontier<vidType>> outbox; // Remote discoveries, per owner
+  std::vector<vidType> send_buffer, recv_buffer;
+  std::vector<int> send_counts, send_displs, recv_counts, recv_displs;
+
+  int owner(vidType v) const;
+  eidType degree(vidType local) const {
+    return rowptr[local + 1] - rowptr[local];
+  }
+  inline bool claim(vidType local, weight_type distance);
+  void exchange();
+  void top_down_step(weight_type distance, uint64_t &edges_frontier);
+  void bottom_up_step(weight_type distance, uint64_t &edges_frontier);
+
+public:
+  using BFS_Impl<eidType>::graph;
+  using BFS_Impl<eidType>::alpha;
+  using BFS_Impl<eidType>::beta;
+
+  Distributed(Graph<eidType> *graph, MPI_Comm comm = MPI_COMM_WORLD);
+  ~Distributed();
+  // Must be called by every rank with the same source
+  void BFS(vidType source, weight_type *distances) override;
+  bool check_result(vidType source, weight_type *distances) override;
+};
+#endif
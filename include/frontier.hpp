@@ -0,0 +1,103 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <omp.h>
+#include <vector>
+
+// Frontier of a level-synchronous BFS. Inside a parallel region each thread
+// appends to its own buffer, then flush() concatenates the buffers at offsets
+// given by a prefix sum of their sizes. Buffers and storage keep their capacity
+// across levels, so the level loop does not allocate once they have grown
+template <typename T> class Frontier {
+private:
+  // Thread-private buffer, padded to avoid false sharing between threads
+  struct alignas(64) Buffer {
+    std::vector<T> items;
+  };
+
+  std::vector<T> items;
+  size_t count = 0;
+  std::vector<Buffer> buffers;
+  std::vector<size_t> offsets;
+
+public:
+  Frontier() { clear(); }
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  const T *begin() const { return items.data(); }
+  const T *end() const { return items.data() + count; }
+  const T &operator[](size_t i) const { return items[i]; }
+
+  // Empty the frontier, keeping its storage. Must be called outside parallel
+  // regions
+  void clear() {
+    count = 0;
+    size_t num_threads = omp_get_max_threads();
+    if (buffers.size() < num_threads) {
+      buffers.resize(num_threads);
+      offsets.resize(num_threads + 1);
+    }
+  }
+
+  // Append a vertex from serial code
+  void push_back(const T &v) {
+    if (count < items.size()) {
+      items[count] = v;
+    } else {
+      items.push_back(v);
+    }
+    count++;
+  }
+
+  // Buffer of the calling thread, to be filled before flush()
+  std::vector<T> &local() { return buffers[omp_get_thread_num()].items; }
+
+  // Append the buffers of all threads to the frontier. Must be reached by every
+  // thread of the enclosing parallel region (or called from serial code)
+  void flush() {
+    int thread = omp_get_thread_num();
+    offsets[thread + 1] = buffers[thread].items.size();
+#pragma omp barrier
+#pragma omp single
+    {
+      int num_threads = omp_get_num_threads();
+      offsets[0] = count;
+      for (int t = 0; t < num_threads; t++) {
+        offsets[t + 1] += offsets[t];
+      }
+      count = offsets[num_threads];
+      if (items.size() < count) {
+        items.resize(count);
+      }
+    }
+    std::vector<T> &local_items = buffers[thread].items;
+    std::copy(local_items.begin(), local_items.end(),
+              items.begin() + offsets[thread]);
+    local_items.clear();
+#pragma omp barrier
+  }
+};
+
+// Top-down steps split frontier vertices with more than HEAVY_DEGREE neighbors
+// into chunks of HEAVY_CHUNK edges, which all threads share after the other
+// vertices, so that a hub does not make its thread the straggler of the level
+#define HEAVY_DEGREE 4096
+#define HEAVY_CHUNK 1024
+
+// Range of the neighbors of a heavy vertex
+template <typename eidType> struct EdgeChunk {
+  eidType begin;
+  eidType end;
+};
+
+// Append the chunks of the neighbor range [begin, end) to chunks
+template <typename eidType>
+inline void split_edges(std::vector<EdgeChunk<eidType>> &chunks, eidType begin,
+                        eidType end) {
+  while (begin < end) {
+    eidType size = std::min<eidType>(HEAVY_CHUNK, end - begin);
+    chunks.push_back({begin, begin + size});
+    begin += size;
+  }
+}
@@ -1,103 +1,281 @@
 #pragma once
+#include "frontier.hpp"
+#include "merged_cache.hpp"
+#include "hugepages.hpp"
+#include "perf_counters.hpp"
+#include "top_down_kernels.hpp"
+#include "trace.hpp"
 #include <cstdint>
+#include <optional>
 #include <string>
 #include <vector>
 
+// Vertex IDs and distances are 32-bit. Edge (and merged layout) indices are a
+// template parameter: uint32_t when the graph fits, uint64_t otherwise
 typedef uint32_t vidType;
-typedef uint32_t eidType;
 typedef uint32_t weight_type;
+// Edge weights of weighted datasets. Weighted shortest path distances use
+// weight_type, so they must fit in 32 bits
+typedef uint32_t wgtType;
 
 typedef enum { TOP_DOWN, BOTTOM_UP } Direction;
 
-using frontier = std::vector<eidType>;
+// How binary datasets are loaded: read into memory, or memory-mapped (lazily
+// or prefaulted with MAP_POPULATE). HEADER only reads N and M, for engines that
+// read their own part of the dataset (Distributed); other datasets are loaded
+// whole
+typedef enum { READ, MMAP, MMAP_POPULATE, HEADER } LoadMode;
 
+// Vertex relabelings applied by Graph::reorder: none, by decreasing degree,
+// reverse Cuthill-McKee, or BFS visit order
+typedef enum { ORDER_NONE, ORDER_DEGREE, ORDER_RCM, ORDER_BFS } Ordering;
+
+// Name of the ordering as used on the command line and in cache file names
+const char *ordering_name(Ordering ordering);
+
+// Default direction switch thresholds, see BFS_Impl::alpha and BFS_Impl::beta
 #define ALPHA 4
 #define BETA 24
 
+// Maximum number of 64-bit words per vertex used by MultiSource
+#define MS_BFS_MAX_WORDS 4
+
+// Returns true if the dataset described by the schema needs 64-bit edge
+// indices, i.e. if the largest layout (MergedCSR_Parents, M + 3N entries, or
+// DeltaStepping, 2M + 2N entries, for weighted datasets) does not fit in 32
+// bits
+bool needs_64bit_index(std::string &schema_path);
+
 // Graph class to store the graph representation in CSR format
-class Graph {
+template <typename eidType> class Graph {
 private:
   void construct_from_coo(std::vector<int64_t> &input_row,
-                          std::vector<int64_t> &input_col);
-  void construct_from_file(std::string &filename);
+                          std::vector<int64_t> &input_col,
+                          std::optional<std::vector<double>> &input_weight);
+  void construct_from_file(std::string &filename, LoadMode load_mode);
+  void map_file(std::string &path, bool populate);
   void generate_random_graph(int64_t num_vertices,
                              int64_t num_edges_per_vertex);
+  template <typename T>
+  void build_rows(const int64_t *src, const int64_t *dst,
+                  const wgtType *edge_weights, uint64_t num_edges,
+                  uint64_t num_vertices, bool symmetrize, bool drop_self_loops);
+
+  // Memory-mapped dataset file (col and weights, and rowptr if eidType is
+  // 64-bit, point inside the mapping)
+  void *mapping = nullptr;
+  size_t mapping_size = 0;
+  bool rowptr_mapped = false;
 
 public:
-  eidType *rowptr;
-  vidType *col;
-  uint64_t N;
-  uint64_t M;
+  eidType *rowptr = nullptr;
+  vidType *col = nullptr;
+  wgtType *weights = nullptr; // Weight of each edge, nullptr if unweighted
+  uint64_t N = 0;
+  uint64_t M = 0;
+  std::vector<vidType> sources; // Source vertices listed in the schema
+  std::string dataset_path;     // Binary dataset (empty if not from a file)
 
-  Graph(eidType *rowptr, vidType *col, uint64_t N, uint64_t M);
-  Graph(std::string &filename);
+  // Relabeling applied by reorder(). new_id maps original IDs to the current
+  // ones and old_id is its inverse. Both are empty unless reordered
+  Ordering ordering = ORDER_NONE;
+  std::vector<vidType> new_id;
+  std::vector<vidType> old_id;
+
+  // Empty graph, to be filled by build_csr. The arrays of a graph are owned
+  // by it and come from large_new (or from the mapping of its dataset)
+  Graph() {}
+  Graph(std::string &filename, LoadMode load_mode = LoadMode::MMAP);
   ~Graph();
   void print_graph();
+
+  // Replace the graph with the CSR of an edge list in any order. Degrees are
+  // counted with atomics, edges are scattered to their rows, then each
+  // neighbor list is sorted and deduplicated, all in parallel. With
+  // symmetrize every edge is added in both directions, and with
+  // drop_self_loops edges (v, v) are skipped. If num_vertices is 0 it is the
+  // largest endpoint + 1. With edge_weights the graph is weighted, and only
+  // the lightest of parallel edges is kept
+  void build_csr(const int64_t *src, const int64_t *dst, uint64_t num_edges,
+                 uint64_t num_vertices = 0, bool symmetrize = false,
+                 bool drop_self_loops = false,
+                 const wgtType *edge_weights = nullptr);
+  bool weighted() const { return weights != nullptr; }
+
+  // Relabel the vertices and rebuild rowptr and col, with sorted neighbor
+  // lists. Must be called before constructing the engines
+  void reorder(Ordering ordering);
+  // Current ID of an original vertex
+  vidType internal_id(vidType v) const {
+    return new_id.empty() ? v : new_id[v];
+  }
+  // Original ID of a current vertex
+  vidType original_id(vidType v) const {
+    return old_id.empty() ? v : old_id[v];
+  }
+  // Permute a per-vertex result back to the original IDs. If the values are
+  // vertex IDs (e.g. parents) they are translated too
+  void restore_order(weight_type *values, bool vertex_values) const;
+  // Free (or unmap) rowptr, col and weights, keeping N, M and the relabeling,
+  // for engines that copy the parts of the graph they need
+  void release_storage();
 };
 
 // Base class for BFS implementations
-class BFS_Impl {
+template <typename eidType> class BFS_Impl {
 public:
-  Graph *graph;
+  Graph<eidType> *graph;
+  // Direction-optimizing engines switch to bottom-up steps when the frontier
+  // has more than unexplored edges / alpha edges, and back to top-down steps
+  // when it has fewer than N / beta vertices
+  uint32_t alpha = ALPHA;
+  uint32_t beta = BETA;
   virtual void BFS(vidType source, weight_type *distances) = 0;
   virtual bool check_result(vidType source, weight_type *distances) = 0;
   bool check_distances(vidType source, const weight_type *distances) const;
   bool check_parents(vidType source, const weight_type *parents) const;
+  // Shortest path distances on the edge weights
+  bool check_weighted_distances(vidType source,
+                                const weight_type *distances) const;
+  virtual ~BFS_Impl() {
+    if (owns_graph)
+      delete graph;
+  }
+  // Keep the graph alive when the engine is deleted, so that several engines
+  // can be built on the same graph
+  void share_graph() { owns_graph = false; }
 
 protected:
-  BFS_Impl(Graph *graph) : graph(graph) {}
-  ~BFS_Impl() { delete graph; }
+  BFS_Impl(Graph<eidType> *graph, bool owns_graph = true)
+      : graph(graph), owns_graph(owns_graph) {}
+  // The BFS invariants on vertex v, whose neighbors are [begin, end)
+  static const char *level_error(vidType source, const weight_type *depth,
+                                 const weight_type *parents, vidType v,
+                                 const vidType *begin, const vidType *end);
+
+private:
+  bool owns_graph;
+
+  // Parallel checks of the BFS invariants, see check_levels in bfs.cpp
+  bool check_levels(vidType source, const weight_type *depth,
+                    const weight_type *parents) const;
 };
 
-// BFS implementation using bitmaps to store frontiers and visited array
-class Bitmap : public BFS_Impl {
+// BFS implementation using bitmaps to store frontiers and visited array. The
+// bitmaps are packed in 64-bit words
+template <typename eidType> class Bitmap : public BFS_Impl<eidType> {
 private:
-  bool *this_frontier;
-  bool *next_frontier;
-  bool *visited;
+  uint64_t words;
+  uint64_t *this_frontier;
+  uint64_t *next_frontier;
+  uint64_t *visited;
+  Frontier<EdgeChunk<eidType>> heavy; // Chunks of heavy frontier vertices
 
-  void bottom_up_step(const bool *this_frontier, bool *next_frontier);
-  void top_down_step(const bool *this_frontier, bool *next_frontier);
-  inline void add_to_frontier(bool *frontier, vidType v);
+  void bottom_up_step(const uint64_t *this_frontier, uint64_t *next_frontier);
+  void top_down_step(const uint64_t *this_frontier, uint64_t *next_frontier);
+  inline void add_to_frontier(uint64_t *frontier, vidType v);
 
 public:
-  Bitmap(Graph *graph);
+  using BFS_Impl<eidType>::graph;
+  using BFS_Impl<eidType>::alpha;
+  using BFS_Impl<eidType>::beta;
+
+  Bitmap(Graph<eidType> *graph);
   ~Bitmap();
   void BFS(vidType source, weight_type *distances) override;
   bool check_result(vidType source, weight_type *distances) override;
 };
 
-// BFS implementation using the MergedCSR graph representation
-class MergedCSR : public BFS_Impl {
+// BFS implementation using the MergedCSR graph representation. Switches between
+// top-down and bottom-up steps like Bitmap, using the inline distances
+template <typename eidType> class MergedCSR : public BFS_Impl<eidType> {
 private:
   eidType *merged_rowptr;
   eidType *merged_csr;
+  MergedCache<eidType> cache;
+  Frontier<eidType> this_frontier;
+  Frontier<eidType> next_frontier;
+  Frontier<EdgeChunk<eidType>> heavy; // Chunks of heavy frontier vertices
+  SimdLevel simd;
+  TopDownKernel<eidType> kernel; // Visits the neighbors in top-down steps
 
-  void top_down_step(const frontier &this_frontier, frontier &next_frontier,
-                     const weight_type &distance);
+  void top_down_step(const Frontier<eidType> &this_frontier,
+                     Frontier<eidType> &next_frontier,
+                     const weight_type &distance, eidType &edges_frontier,
+                     eidType edges_frontier_old);
+  void bottom_up_step(Frontier<eidType> &next_frontier,
+                      const weight_type &distance, eidType &edges_frontier);
   void compute_distances(weight_type *distances, vidType source) const;
   void create_merged_csr();
 
 public:
-  MergedCSR(Graph *graph);
+  using BFS_Impl<eidType>::graph;
+  using BFS_Impl<eidType>::alpha;
+  using BFS_Impl<eidType>::beta;
+
+  MergedCSR(Graph<eidType> *graph, bool use_cache = false);
   ~MergedCSR();
+  // Use the top-down kernel of level, or of the best level below it that is
+  // available. The best one of the CPU is used by default
+  void set_simd(SimdLevel level);
+  SimdLevel simd_level() const { return simd; }
+  void BFS(vidType source, weight_type *distances) override;
+  bool check_result(vidType source, weight_type *distances) override;
+};
+
+// MergedCSR with compressed neighbor lists. Each vertex has a record of 32-bit
+// words: degree, distance, then its sorted neighbor record offsets, encoded as
+// the first offset followed by the deltas in a StreamVByte-like format (one
+// control byte with four 2-bit lengths per group of four 1-4 byte values)
+template <typename eidType>
+class MergedCSR_Compressed : public BFS_Impl<eidType> {
+private:
+  eidType *record_ptr; // Offset of the record of each vertex
+  uint32_t *records;
+  uint64_t words;
+  Frontier<eidType> this_frontier;
+  Frontier<eidType> next_frontier;
+
+  void top_down_step(const Frontier<eidType> &this_frontier,
+                     Frontier<eidType> &next_frontier,
+                     const weight_type &distance, eidType &edges_frontier);
+  void bottom_up_step(Frontier<eidType> &next_frontier,
+                      const weight_type &distance, eidType &edges_frontier);
+  void compute_distances(weight_type *distances, vidType source) const;
+  void create_records();
+
+public:
+  using BFS_Impl<eidType>::graph;
+  using BFS_Impl<eidType>::alpha;
+  using BFS_Impl<eidType>::beta;
+
+  MergedCSR_Compressed(Graph<eidType> *graph);
+  ~MergedCSR_Compressed();
+  // Size of the compressed layout in bytes
+  uint64_t bytes() const { return sizeof(uint32_t) * words; }
   void BFS(vidType source, weight_type *distances) override;
   bool check_result(vidType source, weight_type *distances) override;
 };
 
 // BFS implementation using the MergedCSR graph representation (returning
 // parents)
-class MergedCSR_Parents : public BFS_Impl {
+template <typename eidType> class MergedCSR_Parents : public BFS_Impl<eidType> {
 private:
   eidType *merged_rowptr;
   eidType *merged_csr;
+  MergedCache<eidType> cache;
+  Frontier<eidType> this_frontier;
+  Frontier<eidType> next_frontier;
 
-  void top_down_step(const frontier &this_frontier, frontier &next_frontier);
+  void top_down_step(const Frontier<eidType> &this_frontier,
+                     Frontier<eidType> &next_frontier);
   void compute_parents(weight_type *parents, vidType source) const;
   void create_merged_csr();
 
 public:
-  MergedCSR_Parents(Graph *graph);
+  using BFS_Impl<eidType>::graph;
+
+  MergedCSR_Parents(Graph<eidType> *graph, bool use_cache = false);
   ~MergedCSR_Parents();
   void BFS(vidType source, weight_type *distances) override;
   bool check_result(vidType source, weight_type *distances) override;
@@ -105,32 +283,188 @@ public:
 
 // BFS implementation using bitmaps to store visited array. Frontiers are stored
 // as vectors
-class Classic : public BFS_Impl {
+template <typename eidType> class Classic : public BFS_Impl<eidType> {
 private:
   bool *visited;
+  Frontier<vidType> this_frontier;
+  Frontier<vidType> next_frontier;
+  Frontier<EdgeChunk<eidType>> heavy; // Chunks of heavy frontier vertices
 
   inline void set_distance(vidType i, weight_type distance,
                            weight_type *distances);
-  inline void add_to_frontier(frontier &frontier, vidType v,
-                              vidType &edges_frontier);
-  void bottom_up_step(frontier this_frontier, frontier &next_frontier,
-                      weight_type distance, weight_type *distances,
-                      vidType &edges_frontier);
-  void top_down_step(frontier this_frontier, frontier &next_frontier,
-                     weight_type &distance, weight_type *distances,
-                     vidType &edges_frontier, vidType edges_frontier_old);
+  inline void add_to_frontier(std::vector<vidType> &frontier, vidType v,
+                              eidType &edges_frontier);
+  void bottom_up_step(const Frontier<vidType> &this_frontier,
+                      Frontier<vidType> &next_frontier, weight_type distance,
+                      weight_type *distances, eidType &edges_frontier);
+  void top_down_step(const Frontier<vidType> &this_frontier,
+                     Frontier<vidType> &next_frontier, weight_type &distance,
+                     weight_type *distances, eidType &edges_frontier,
+                     eidType edges_frontier_old);
 
 public:
-  Classic(Graph *graph);
+  using BFS_Impl<eidType>::graph;
+  using BFS_Impl<eidType>::alpha;
+  using BFS_Impl<eidType>::beta;
+
+  Classic(Graph<eidType> *graph);
   ~Classic();
   void BFS(vidType source, weight_type *distances) override;
   bool check_result(vidType source, weight_type *distances) override;
 };
 
+// Delta-stepping single-source shortest paths on a weighted MergedCSR layout.
+// Each vertex has a record with its degree, its distance, then a (neighbor
+// record offset, weight) pair per edge, so that relaxing an edge reads its
+// weight next to the offset. Vertices wait in buckets of width delta; each step
+// relaxes the edges of the smallest non-empty bucket and puts the improved
+// vertices in thread-private buckets. Needs a weighted dataset
+template <typename eidType> class DeltaStepping : public BFS_Impl<eidType> {
+private:
+  // Buckets of one thread, padded to avoid false sharing between threads.
+  // Relaxing bucket b only reaches buckets up to b + ceil(max_weight / delta),
+  // so the bins are cyclic: bucket b is in bin b % bins.size()
+  struct alignas(64) Buckets {
+    std::vector<std::vector<eidType>> bins;
+    std::vector<uint64_t> occupied; // Bitmap of the non-empty bins
+
+    void resize(size_t num_bins);
+    void push(size_t b, eidType vertex);
+    // Move bucket b to out, which must be empty
+    void take(size_t b, std::vector<eidType> &out);
+    // Smallest non-empty bucket from b, or NO_BUCKET
+    size_t next(size_t b) const;
+    size_t first_occupied(size_t from, size_t to) const;
+  };
+
+  eidType *merged_rowptr;
+  eidType *merged_csr;
+  weight_type max_weight = 0;
+  Frontier<eidType> this_frontier;
+  Frontier<eidType> next_frontier;
+  std::vector<Buckets> buckets;
+
+  size_t relax_step(size_t bucket);
+  void compute_distances(weight_type *distances) const;
+  void create_merged_csr();
+
+public:
+  using BFS_Impl<eidType>::graph;
+  weight_type delta; // Width of the buckets
+
+  // With delta 0 the width is the mean edge weight
+  DeltaStepping(Graph<eidType> *graph, weight_type delta = 0);
+  ~DeltaStepping();
+  // Weighted distances from source
+  void BFS(vidType source, weight_type *distances) override;
+  bool check_result(vidType source, weight_type *distances) override;
+};
+
+// Multi-source BFS implementation (MS-BFS). Runs a batch of up to 64 *
+// batch_words sources in one pass, using a bitset per vertex to record which
+// searches have reached it, so each adjacency list is read once per level for
+// the whole batch
+template <typename eidType> class MultiSource : public BFS_Impl<eidType> {
+private:
+  uint32_t batch_words;
+  uint64_t *seen;
+  uint64_t *visit;
+  uint64_t *visit_next;
+  bool *in_next;
+  Frontier<vidType> this_frontier;
+  Frontier<vidType> next_frontier;
+
+  void top_down_step(const Frontier<vidType> &this_frontier,
+                     Frontier<vidType> &next_frontier);
+  void update_frontier(const Frontier<vidType> &this_frontier,
+                       const Frontier<vidType> &next_frontier,
+                       weight_type distance, weight_type **distances);
+  void run_batch(const vidType *sources, uint32_t num_sources,
+                 weight_type **distances);
+
+public:
+  using BFS_Impl<eidType>::graph;
+
+  MultiSource(Graph<eidType> *graph, uint32_t batch_words = 1);
+  ~MultiSource();
+  uint32_t batch_size() const { return 64 * batch_words; }
+  void BFS(vidType source, weight_type *distances) override;
+  void BFS(const std::vector<vidType> &sources, weight_type **distances);
+  bool check_result(vidType source, weight_type *distances) override;
+};
+
+// Direction-optimizing BFS that keeps the vertices reached by the last query,
+// level by level, so that the per-query state (depths and parents) is reset
+// only for them instead of with a sweep over all vertices. Used by the query
+// server, where most queries reach a small part of the graph
+template <typename eidType> class Sparse : public BFS_Impl<eidType> {
+private:
+  weight_type *depth;        // Largest value for the unreached vertices
+  vidType *parent;           // Valid for the reached vertices only
+  Frontier<vidType> reached; // Vertices reached by the last query, by level
+  Frontier<EdgeChunk<eidType>> heavy; // Chunks of heavy frontier vertices
+
+  inline bool claim(vidType v, vidType from, weight_type distance);
+  void top_down_step(size_t begin, size_t end, weight_type distance,
+                     eidType &edges_frontier, eidType edges_frontier_old);
+  void bottom_up_step(weight_type distance, eidType &edges_frontier);
+
+public:
+  using BFS_Impl<eidType>::graph;
+  using BFS_Impl<eidType>::alpha;
+  using BFS_Impl<eidType>::beta;
+
+  Sparse(Graph<eidType> *graph);
+  ~Sparse();
+  // Traverse from source. The result stays available until reset()
+  void query(vidType source);
+  // Vertices reached by the last query, in BFS order
+  const Frontier<vidType> &visited() const { return reached; }
+  weight_type depth_of(vidType v) const { return depth[v]; }
+  vidType parent_of(vidType v) const { return parent[v]; }
+  // Clear the state of the vertices reached by the last query
+  void reset();
+  // Writes the distances of the reached vertices only, so the other entries
+  // must already hold the largest value
+  void BFS(vidType source, weight_type *distances) override;
+  bool check_result(vidType source, weight_type *distances) override;
+};
+
+// Point-to-point BFS. Searches from both endpoints, always expanding the side
+// whose frontier has fewer edges, and stops at the level where the two searches
+// meet. The graph must be symmetric, as the datasets are. Like Sparse, only
+// the vertices reached by a query are reset
+template <typename eidType> class Bidirectional {
+private:
+  // Search from one endpoint
+  struct Side {
+    weight_type *depth;        // Largest value for the unreached vertices
+    Frontier<vidType> reached; // Reached vertices, by level
+    size_t begin;              // Start of the frontier in reached
+    weight_type level;         // Depth of the frontier
+    eidType edges;             // Edges of the frontier
+  };
+  Side sides[2];
+  Frontier<EdgeChunk<eidType>> heavy; // Chunks of heavy frontier vertices
+
+  weight_type expand(Side &side, const Side &other);
+  void reset();
+
+public:
+  Graph<eidType> *graph;
+
+  Bidirectional(Graph<eidType> *graph);
+  ~Bidirectional();
+  // Hop distance from source to target (the largest value if unreachable)
+  weight_type distance(vidType source, vidType target);
+};
+
 // Single-threaded BFS implementation using classic CSR
-class Reference : public BFS_Impl {
+template <typename eidType> class Reference : public BFS_Impl<eidType> {
 public:
-  Reference(Graph *graph);
+  using BFS_Impl<eidType>::graph;
+
+  Reference(Graph<eidType> *graph, bool owns_graph = true);
   ~Reference();
   void BFS(vidType source, weight_type *distances) override;
   bool check_result(vidType source, weight_type *distances) override;
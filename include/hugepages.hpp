@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdio>
+
+// Page backing of the large arrays of the graph and of the engines. THP maps
+// 2 MB aligned memory and asks for transparent huge pages with MADV_HUGEPAGE.
+// HUGETLB maps explicit 2 MB pages from the hugetlbfs pool
+// (/proc/sys/vm/nr_hugepages), falling back to THP when the pool is short.
+// Arrays smaller than a huge page always get base pages
+typedef enum { PAGES_DEFAULT, PAGES_THP, PAGES_HUGETLB } PageMode;
+
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+void set_page_mode(PageMode mode);
+
+// Allocate bytes with the page mode, then apply the NUMA placement. The memory
+// is zeroed but not touched, so both policies apply to every page
+void *large_alloc(size_t bytes);
+void large_free(void *ptr);
+
+// Replacement of new[] for large arrays of trivial types; release them with
+// large_delete
+template <typename T> T *large_new(size_t count) {
+  return static_cast<T *>(large_alloc(sizeof(T) * count));
+}
+
+template <typename T> void large_delete(T *ptr) { large_free(ptr); }
+
+// Print the bytes of the live arrays by backing obtained. For THP arrays, the
+// bytes actually backed by huge pages are read from /proc/self/smaps
+void page_report(FILE *out);
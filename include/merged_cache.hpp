@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+template <typename eidType> class Graph;
+
+// On-disk cache of the MergedCSR layouts, stored beside the binary dataset as
+// <dataset>.merged_csr<bits> or <dataset>.merged_csr_parents<bits>. The file
+// holds a MergedCacheHeader followed by merged_rowptr (N + 1 entries) and
+// merged_csr (M + slots * N entries)
+#define MERGED_CACHE_VERSION 1
+
+// Layout variant, identified by the number of header slots per vertex
+typedef enum { MERGED_DISTANCES = 2, MERGED_PARENTS = 3 } MergedVariant;
+
+struct MergedCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t variant;
+  uint32_t index_bytes;
+  uint32_t reserved;
+  uint64_t N;
+  uint64_t M;
+  uint64_t checksum; // Checksum of merged_rowptr and merged_csr
+};
+
+// Merged layout mapped from a cache file. The mapping is private, so distance
+// and parent slots written during the BFS never reach the file
+template <typename eidType> class MergedCache {
+private:
+  void *mapping = nullptr;
+  size_t mapping_size = 0;
+
+public:
+  ~MergedCache();
+  bool is_mapped() const { return mapping != nullptr; }
+
+  // Map the cache of the given graph and variant. Returns false if there is
+  // no cache, or if it is stale or does not match the graph
+  bool load(const Graph<eidType> *graph, MergedVariant variant,
+            eidType *&merged_rowptr, eidType *&merged_csr);
+  // Write the merged layout of the graph to its cache file
+  static void store(const Graph<eidType> *graph, MergedVariant variant,
+                    const eidType *merged_rowptr, const eidType *merged_csr);
+};
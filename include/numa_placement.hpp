@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+
+// NUMA placement of the graph and of the per-vertex state of the engines.
+// INTERLEAVE spreads the pages of each array round-robin over the nodes.
+// PARTITION splits each array in as many contiguous chunks as threads, like
+// schedule(static), and places each chunk on the node of the thread that owns
+// it. In both modes the OpenMP threads are pinned, filling one node before the
+// next, so consecutive threads share a node
+typedef enum { NUMA_OFF, NUMA_INTERLEAVE, NUMA_PARTITION } NumaMode;
+
+// Detect the nodes and pin the threads. On a single-node machine placement is
+// disabled (threads are still pinned). Returns the number of nodes in use
+int numa_setup(NumaMode mode);
+
+// Apply the placement policy to an array that has not been touched yet. Pages
+// already touched are migrated. No-op when placement is disabled
+void numa_place(void *ptr, size_t bytes);
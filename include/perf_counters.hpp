@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+// Hardware counters collected with perf_event_open on every OpenMP thread
+typedef enum {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_LLC_MISSES,
+  PERF_DTLB_MISSES,
+  PERF_STALLS_BACKEND, // Cycles stalled on the back end, mostly memory
+  PERF_NUM_EVENTS
+} PerfEvent;
+
+// Counter totals of a code region over all threads and calls
+struct PerfTotals {
+  uint64_t calls = 0;
+  uint64_t values[PERF_NUM_EVENTS] = {};
+};
+
+// Counters of the threads of the OpenMP pool, opened on first use. Events the
+// machine does not support (or that the kernel does not allow) are skipped
+class PerfCounters {
+private:
+  std::vector<int> fds;    // PERF_NUM_EVENTS per thread, -1 if unavailable
+  bool available[PERF_NUM_EVENTS] = {};
+  bool opened = false;
+  std::map<std::string, PerfTotals> regions;
+
+  PerfCounters() = default;
+  void open();
+
+public:
+  ~PerfCounters();
+  static PerfCounters &instance();
+  // Sum of each counter over all threads
+  void read(uint64_t *values);
+  void add(const char *region, const uint64_t *start, const uint64_t *end);
+  // Print the totals of every region, e.g. "MergedCSR::top_down_step"
+  void report(FILE *out);
+  // Write the totals of every region as CSV
+  void write_csv(const std::string &path);
+};
+
+// Counts the events between its construction and destruction. Must be created
+// outside parallel regions
+class PerfRegion {
+private:
+  const char *name;
+  uint64_t start[PERF_NUM_EVENTS];
+
+public:
+  PerfRegion(const char *name) : name(name) {
+    PerfCounters::instance().read(start);
+  }
+  ~PerfRegion() {
+    uint64_t end[PERF_NUM_EVENTS];
+    PerfCounters::instance().read(end);
+    PerfCounters::instance().add(name, start, end);
+  }
+};
+
+// Counters are compiled in with -DBFS_PERF=ON
+#ifdef BFS_PERF
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_(a, b)
+#define PERF_REGION(name) PerfRegion PERF_CONCAT(perf_region_, __LINE__)(name)
+#else
+#define PERF_REGION(name)
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+#include "graph.hpp"
+#include <string>
+
+// Probes stop after this many levels: the graph has a large diameter
+#define SELECTOR_MAX_LEVELS 64
+// Below this many levels the graph has a small diameter
+#define SELECTOR_SMALL_LEVELS 16
+// In between, graphs whose degree coefficient of variation exceeds this are
+// treated as small-diameter ones, as hubs make bottom-up steps cheap
+#define SELECTOR_SKEW 1.0
+// Each probe scans at most M / SELECTOR_EDGE_FRACTION edges (and at least
+// SELECTOR_MIN_EDGES), so that the estimate stays much cheaper than a BFS
+#define SELECTOR_EDGE_FRACTION 64
+#define SELECTOR_MIN_EDGES (1 << 20)
+
+// Engine picked by select_engine and the evidence behind the choice
+struct EngineChoice {
+  std::string engine; // 'merged_csr' or 'bitmap'
+  std::string reason;
+  uint32_t levels;    // Largest number of levels reached by the probes
+  double avg_degree;
+  double degree_cv;   // Coefficient of variation of the degrees
+  uint32_t max_degree;
+  bool cached;
+};
+
+// Choose between MergedCSR (large diameter) and Bitmap (small diameter). The
+// degree distribution is swept from rowptr and the diameter is estimated with
+// a double sweep of BFS probes capped at SELECTOR_MAX_LEVELS levels and at an
+// edge budget. A probe that runs out of edges first has found a fast-growing
+// frontier, and its levels so far are the estimate. With
+// use_cache, the decision is read from and stored to the tuning file of the
+// schema
+template <typename eidType>
+EngineChoice select_engine(const Graph<eidType> *graph,
+                           const std::string &schema_path, bool use_cache);
@@ -0,0 +1,14 @@
+#pragma once
+#include "graph.hpp"
+#include <string>
+
+// Answer BFS queries with an engine built once, from stdin (replying on
+// stdout) or from the clients of a Unix socket, served one at a time. Each
+// line is a query "<source> [distances|parents]" (distances by default), or
+// "quit" to stop the server. The reply is a line "<source> <reached>
+// <seconds>" followed by one "<vertex> <value>" line per reached vertex, in
+// BFS order, or "error <reason>". A query "<source> <target>" is answered by
+// Bidirectional with a line "<source> <target> <distance> <seconds>". IDs are
+// those of the dataset
+template <typename eidType>
+int run_server(Sparse<eidType> *bfs, const std::string &socket_path);
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Instruction sets of the top-down kernels of MergedCSR. They are detected at
+// runtime, so a binary built for a newer CPU still runs its scalar kernel
+typedef enum { SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512 } SimdLevel;
+
+// Name of the level as used on the command line, and its inverse
+const char *simd_name(SimdLevel level);
+SimdLevel parse_simd_level(const std::string &name);
+// Best level supported by the CPU
+SimdLevel detect_simd();
+
+// Visit the neighbor record offsets merged_csr[begin, end) of a top-down step
+// on the MergedCSR layout: every neighbor whose inline distance is unvisited
+// gets distance, and is appended to frontier unless its degree is 1. Returns
+// the degrees of the appended neighbors
+template <typename eidType>
+using TopDownKernel = eidType (*)(eidType *merged_csr, eidType begin,
+                                  eidType end, uint32_t distance,
+                                  std::vector<eidType> &frontier);
+
+// Kernel for level on a layout of the given number of words. The level is
+// lowered to what the CPU supports, and to scalar for 32-bit layouts of 2^31
+// words or more, whose offsets do not fit the signed indices of the gathers
+template <typename eidType>
+TopDownKernel<eidType> top_down_kernel(SimdLevel &level, uint64_t words);
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-level statistics of a traversal
+struct TraceLevel {
+  int direction;              // Direction of the step
+  uint64_t frontier_vertices; // Vertices in the frontier expanded by the step
+  uint64_t frontier_edges;    // Their edges (TRACE_UNKNOWN if not tracked)
+  uint64_t unexplored_edges;  // Edges not yet explored (TRACE_UNKNOWN too)
+  double time;                // Seconds spent in the step
+};
+
+#define TRACE_UNKNOWN UINT64_MAX
+
+// Levels of every BFS run since the start of the program. Runs are recorded
+// by the serial level loop of each engine
+class Trace {
+private:
+  struct Run {
+    std::string engine;
+    uint32_t source;
+    std::vector<TraceLevel> levels;
+  };
+  std::vector<Run> runs;
+  double level_start = 0;
+
+public:
+  static Trace &instance();
+  void begin_run(const char *engine, uint32_t source);
+  void begin_level(int direction, uint64_t frontier_vertices,
+                   uint64_t frontier_edges, uint64_t unexplored_edges);
+  void end_level();
+  // Write one row per level as CSV if path ends in .csv, JSON otherwise
+  void write(const std::string &path) const;
+};
+
+// The trace is compiled in with -DBFS_TRACE=ON
+#ifdef BFS_TRACE
+#define TRACE_RUN(engine, source) Trace::instance().begin_run(engine, source)
+#define TRACE_LEVEL_BEGIN(direction, vertices, edges, unexplored)             \
+  Trace::instance().begin_level(direction, vertices, edges, unexplored)
+#define TRACE_LEVEL_END() Trace::instance().end_level()
+#else
+#define TRACE_RUN(engine, source)
+#define TRACE_LEVEL_BEGIN(direction, vertices, edges, unexplored)
+#define TRACE_LEVEL_END()
+#endif
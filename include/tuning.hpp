@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+
+// Per-dataset tuning decisions, stored beside the schema as
+// schemas/<name>.tuning.json. Each entry is an object under its own key and
+// records N and M, so entries of a dataset that changed are ignored
+
+// Entry key of the tuning file, or null if it is missing or was made for a
+// different graph
+nlohmann::json read_tuning(const std::string &schema_path,
+                           const std::string &key, uint64_t N, uint64_t M);
+
+// Store an entry, keeping the other entries of the file
+void write_tuning(const std::string &schema_path, const std::string &key,
+                  nlohmann::json entry, uint64_t N, uint64_t M);
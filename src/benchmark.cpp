@@ -0,0 +1,230 @@
+#include "benchmark.hpp"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <nlohmann/json.hpp>
+#include <omp.h>
+#include <random>
+#include <unordered_set>
+
+template <typename eidType>
+std::vector<vidType> random_sources(const Graph<eidType> *graph,
+                                    uint32_t num_sources, uint64_t seed) {
+  uint64_t non_isolated = 0;
+#pragma omp parallel for reduction(+ : non_isolated) schedule(static)
+  for (vidType v = 0; v < graph->N; v++) {
+    non_isolated += graph->rowptr[v + 1] != graph->rowptr[v];
+  }
+  num_sources = std::min<uint64_t>(num_sources, non_isolated);
+
+  std::mt19937_64 rng(seed);
+  std::uniform_int_distribution<vidType> vertex(0, graph->N - 1);
+  std::unordered_set<vidType> picked;
+  std::vector<vidType> sources;
+  while (sources.size() < num_sources) {
+    vidType v = vertex(rng);
+    if (graph->rowptr[v + 1] != graph->rowptr[v] && picked.insert(v).second) {
+      sources.push_back(v);
+    }
+  }
+  return sources;
+}
+
+// Number of edges of the vertices reached by a BFS. Unreached vertices hold
+// the largest value, both as distances and as parents
+template <typename eidType>
+static uint64_t traversed_edges(const Graph<eidType> *graph,
+                                const weight_type *result) {
+  uint64_t edges = 0;
+#pragma omp parallel for reduction(+ : edges) schedule(static)
+  for (vidType v = 0; v < graph->N; v++) {
+    if (result[v] != std::numeric_limits<weight_type>::max()) {
+      edges += graph->rowptr[v + 1] - graph->rowptr[v];
+    }
+  }
+  return edges;
+}
+
+// Timing of one engine over all sources and trials
+struct EngineResult {
+  std::string name;
+  double init_time;
+  std::vector<vidType> sources;
+  std::vector<uint64_t> edges;             // Per source
+  std::vector<std::vector<double>> times;  // Per source and trial
+  bool correct = true;
+};
+
+struct Summary {
+  double min, median, mean;
+  double median_gteps, hmean_gteps;
+};
+
+static Summary summarize(const EngineResult &result) {
+  std::vector<double> times, gteps;
+  double total_time = 0;
+  for (size_t s = 0; s < result.sources.size(); s++) {
+    for (double t : result.times[s]) {
+      times.push_back(t);
+      gteps.push_back(result.edges[s] / t * 1e-9);
+      total_time += t;
+    }
+  }
+  Summary summary = {};
+  if (times.empty()) {
+    return summary;
+  }
+  std::sort(times.begin(), times.end());
+  std::sort(gteps.begin(), gteps.end());
+  summary.min = times.front();
+  summary.median = times[times.size() / 2];
+  summary.mean = total_time / times.size();
+  summary.median_gteps = gteps[gteps.size() / 2];
+  // The harmonic mean of the TEPS, as in Graph500
+  double inverse_sum = 0;
+  for (double g : gteps) {
+    inverse_sum += 1 / g;
+  }
+  summary.hmean_gteps = gteps.size() / inverse_sum;
+  return summary;
+}
+
+template <typename eidType>
+static void write_report(const Graph<eidType> *graph,
+                         const std::vector<EngineResult> &results,
+                         const BenchmarkConfig &config) {
+  std::ofstream out(config.report);
+  if (!out.is_open()) {
+    printf("Warning: unable to write report %s\n", config.report.c_str());
+    return;
+  }
+  bool csv = config.report.size() >= 4 &&
+             config.report.compare(config.report.size() - 4, 4, ".csv") == 0;
+  if (csv) {
+    out << "engine,sources,trials,init_s,min_s,median_s,mean_s,median_gteps,"
+           "hmean_gteps,correct\n";
+    for (const EngineResult &result : results) {
+      Summary summary = summarize(result);
+      out << result.name << "," << result.sources.size() << ","
+          << config.trials << "," << result.init_time << "," << summary.min
+          << "," << summary.median << "," << summary.mean << ","
+          << summary.median_gteps << "," << summary.hmean_gteps << ","
+          << (result.correct ? "true" : "false") << "\n";
+    }
+    return;
+  }
+  nlohmann::json report;
+  report["dataset"] = graph->dataset_path;
+  report["N"] = graph->N;
+  report["M"] = graph->M;
+  report["threads"] = omp_get_max_threads();
+  report["index_bits"] = 8 * sizeof(eidType);
+  report["ordering"] = ordering_name(graph->ordering);
+  report["warmup"] = config.warmup;
+  report["trials"] = config.trials;
+  for (const EngineResult &result : results) {
+    Summary summary = summarize(result);
+    nlohmann::json engine;
+    engine["engine"] = result.name;
+    engine["init_s"] = result.init_time;
+    engine["min_s"] = summary.min;
+    engine["median_s"] = summary.median;
+    engine["mean_s"] = summary.mean;
+    engine["median_gteps"] = summary.median_gteps;
+    engine["hmean_gteps"] = summary.hmean_gteps;
+    engine["correct"] = result.correct;
+    for (size_t s = 0; s < result.sources.size(); s++) {
+      // Sources are reported with the IDs of the dataset
+      vidType source = graph->old_id.empty() ? result.sources[s]
+                                             : graph->old_id[result.sources[s]];
+      engine["runs"].push_back({{"source", source},
+                                {"edges", result.edges[s]},
+                                {"times_s", result.times[s]}});
+    }
+    report["engines"].push_back(engine);
+  }
+  out << report.dump(2) << "\n";
+}
+
+template <typename eidType>
+int run_benchmark(Graph<eidType> *graph,
+                  const EngineFactory<eidType> &make_engine,
+                  const BenchmarkConfig &config) {
+  std::vector<vidType> sources;
+  if (config.num_sources == 0) {
+    for (vidType source : graph->sources) {
+      sources.push_back(graph->internal_id(source));
+    }
+  }
+  if (sources.empty()) {
+    uint32_t num_sources =
+        config.num_sources ? config.num_sources : BENCHMARK_DEFAULT_SOURCES;
+    sources = random_sources(graph, num_sources, config.seed);
+  }
+  printf("Benchmark: %zu sources, %u warm-up and %u timed runs each\n",
+         sources.size(), config.warmup, config.trials);
+
+  weight_type *result = large_new<weight_type>(graph->N);
+  std::vector<EngineResult> results;
+  for (const std::string &name : config.engines) {
+    EngineResult engine_result;
+    engine_result.name = name;
+    engine_result.sources = sources;
+
+    double t_start = omp_get_wtime();
+    BFS_Impl<eidType> *bfs = make_engine(graph, name);
+    bfs->share_graph();
+    engine_result.init_time = omp_get_wtime() - t_start;
+
+    for (vidType source : sources) {
+      std::vector<double> times;
+      for (uint32_t run = 0; run < config.warmup + config.trials; run++) {
+        std::fill_n(result, graph->N, std::numeric_limits<weight_type>::max());
+        t_start = omp_get_wtime();
+        bfs->BFS(source, result);
+        double time = omp_get_wtime() - t_start;
+        if (run == 0) {
+          engine_result.edges.push_back(traversed_edges(graph, result));
+          if (config.check) {
+            engine_result.correct &= bfs->check_result(source, result);
+          }
+        }
+        if (run >= config.warmup) {
+          times.push_back(time);
+        }
+      }
+      engine_result.times.push_back(times);
+    }
+    delete bfs;
+
+    Summary summary = summarize(engine_result);
+    printf("%-20s init %.6f  min %.6f  median %.6f  mean %.6f  "
+           "GTEPS %.3f (median) %.3f (harmonic mean)%s\n",
+           name.c_str(), engine_result.init_time, summary.min, summary.median,
+           summary.mean, summary.median_gteps, summary.hmean_gteps,
+           engine_result.correct ? "" : "  INCORRECT");
+    results.push_back(std::move(engine_result));
+  }
+  large_delete(result);
+
+  if (!config.report.empty()) {
+    write_report(graph, results, config);
+  }
+  for (const EngineResult &engine_result : results) {
+    if (!engine_result.correct) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+template std::vector<vidType> random_sources(const Graph<uint32_t> *,
+                                             uint32_t, uint64_t);
+template std::vector<vidType> random_sources(const Graph<uint64_t> *,
+                                             uint32_t, uint64_t);
+template int run_benchmark(Graph<uint32_t> *,
+                           const EngineFactory<uint32_t> &,
+                           const BenchmarkConfig &);
+template int run_benchmark(Graph<uint64_t> *,
+                           const EngineFactory<uint64_t> &,
+                           const BenchmarkConfig &);
@@ -1,17 +1,121 @@
 #include "graph.hpp"
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <queue>
 
-bool BFS_Impl::check_distances(vidType source,
-                               const weight_type *distances) const {
-  Reference ref_input(graph);
-  weight_type *ref_distances = new weight_type[graph->N];
-  std::fill(ref_distances, ref_distances + graph->N, -1);
-  ref_input.BFS(source, ref_distances);
+#define UNREACHED std::numeric_limits<weight_type>::max()
+
+// Check the BFS invariants of depth in parallel, Graph500 style, without
+// recomputing a reference: the source is at level 0, every edge from a reached
+// vertex leads to a vertex at most one level deeper, and every other reached
+// vertex has a neighbor one level closer (its parent, if parents is given).
+// Together they imply that depth is the hop distance, as long as the graph is
+// symmetric. Returns the reason of the first error of v, or nullptr
+template <typename eidType>
+const char *BFS_Impl<eidType>::level_error(vidType source,
+                                           const weight_type *depth,
+                                           const weight_type *parents,
+                                           vidType v, const vidType *begin,
+                                           const vidType *end) {
+  weight_type d = depth[v];
+  if (v == source) {
+    if (d != 0 || (parents != nullptr && parents[v] != source)) {
+      return "the source is not at depth 0 or is not its own parent";
+    }
+  } else if (d == 0) {
+    return "depth 0 on a vertex other than the source";
+  }
+  if (d == UNREACHED) {
+    return nullptr;
+  }
+  bool closer = v == source;
+  for (const vidType *i = begin; i < end; i++) {
+    vidType neighbor = *i;
+    if (depth[neighbor] > d + 1) {
+      return "an edge spans more than one level";
+    }
+    if (depth[neighbor] == d - 1 &&
+        (parents == nullptr || parents[v] == neighbor)) {
+      closer = true;
+    }
+  }
+  if (!closer) {
+    return parents == nullptr ? "no neighbor one level closer"
+                              : "the parent is not a neighbor one level closer";
+  }
+  return nullptr;
+}
+
+template <typename eidType>
+bool BFS_Impl<eidType>::check_levels(vidType source, const weight_type *depth,
+                                     const weight_type *parents) const {
+  if (source >= graph->N) {
+    std::cout << "Invalid source " << source << std::endl;
+    return false;
+  }
+  uint64_t errors = 0;
+  vidType first = graph->N;
+#pragma omp parallel for reduction(+ : errors) reduction(min : first)         \
+    schedule(dynamic, 1024)
+  for (vidType v = 0; v < graph->N; v++) {
+    if (level_error(source, depth, parents, v, graph->col + graph->rowptr[v],
+                    graph->col + graph->rowptr[v + 1]) != nullptr) {
+      errors++;
+      first = std::min(first, v);
+    }
+  }
+  if (errors != 0) {
+    std::cout << "Incorrect value for vertex " << first << " at depth "
+              << depth[first] << ": "
+              << level_error(source, depth, parents, first,
+                             graph->col + graph->rowptr[first],
+                             graph->col + graph->rowptr[first + 1])
+              << " ("
+              << errors << " incorrect vertices)" << std::endl;
+  }
+  return errors == 0;
+}
+
+template <typename eidType>
+bool BFS_Impl<eidType>::check_distances(vidType source,
+                                        const weight_type *distances) const {
+  return check_levels(source, distances, nullptr);
+}
+
+// Compare with the distances of a serial Dijkstra on the weighted graph
+template <typename eidType>
+bool BFS_Impl<eidType>::check_weighted_distances(
+    vidType source, const weight_type *distances) const {
+  std::vector<uint64_t> ref_distances(graph->N,
+                                      std::numeric_limits<uint64_t>::max());
+  typedef std::pair<uint64_t, vidType> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+  ref_distances[source] = 0;
+  queue.push({0, source});
+  while (!queue.empty()) {
+    auto [distance, v] = queue.top();
+    queue.pop();
+    if (distance > ref_distances[v]) {
+      continue;
+    }
+    for (eidType i = graph->rowptr[v]; i < graph->rowptr[v + 1]; i++) {
+      uint64_t candidate = distance + graph->weights[i];
+      if (candidate < ref_distances[graph->col[i]]) {
+        ref_distances[graph->col[i]] = candidate;
+        queue.push({candidate, graph->col[i]});
+      }
+    }
+  }
   bool correct = true;
-  for (int64_t i = 0; i < graph->N; i++) {
-    if (distances[i] != ref_distances[i]) {
+  for (uint64_t i = 0; i < graph->N; i++) {
+    uint64_t expected = ref_distances[i] == std::numeric_limits<uint64_t>::max()
+                            ? std::numeric_limits<weight_type>::max()
+                            : ref_distances[i];
+    if (distances[i] != expected) {
       std::cout << "Incorrect value for vertex " << i
-                << ", expected distance " + std::to_string(ref_distances[i]) +
+                << ", expected distance " + std::to_string(expected) +
                        ", but got " + std::to_string(distances[i]) + "\n";
       correct = false;
     }
@@ -19,60 +123,75 @@ bool BFS_Impl::check_distances(vidType source,
   return correct;
 }
 
-bool BFS_Impl::check_parents(vidType source, const weight_type *parents) const {
-  bool correct = true;
-  std::vector<vidType> depth(graph->N, -1);
-  std::vector<vidType> to_visit;
-  depth[source] = 0;
-  to_visit.push_back(source);
-  to_visit.reserve(graph->N);
-  // Run BFS to compute depth of each vertex
-  for (auto it = to_visit.begin(); it != to_visit.end(); it++) {
-    vidType i = *it;
-    for (int64_t v = graph->rowptr[i]; v < graph->rowptr[i + 1]; v++) {
-      if (depth[graph->col[v]] == -1) {
-        depth[graph->col[v]] = depth[i] + 1;
-        to_visit.push_back(graph->col[v]);
-      }
+// The depths of the BFS tree are found by pointer jumping: every round adds the
+// distance to the current ancestor of each vertex, then jumps to the ancestor
+// of that ancestor, so about log2(N) rounds reach the source. A vertex whose
+// ancestors never reach it lies on a cycle or below an unreached vertex
+template <typename eidType>
+bool BFS_Impl<eidType>::check_parents(vidType source,
+                                      const weight_type *parents) const {
+  if (source >= graph->N) {
+    std::cout << "Invalid source " << source << std::endl;
+    return false;
+  }
+  std::vector<vidType> ancestor(graph->N), next_ancestor(graph->N);
+  std::vector<uint64_t> steps(graph->N), next_steps(graph->N);
+  uint64_t invalid = 0;
+#pragma omp parallel for reduction(+ : invalid) schedule(static)
+  for (vidType v = 0; v < graph->N; v++) {
+    if (v == source || parents[v] == UNREACHED || parents[v] >= graph->N) {
+      invalid += v != source && parents[v] != UNREACHED;
+      ancestor[v] = v == source ? source : parents[v];
+      steps[v] = v == source ? 0 : UNREACHED;
+    } else {
+      ancestor[v] = parents[v];
+      steps[v] = 1;
     }
   }
-  for (int64_t i = 0; i < graph->N; i++) {
-    // Check if vertex is part of the BFS tree
-    if (depth[i] != -1 && parents[i] != -1) {
-      // Check if parent is correct
-      if (i == source) {
-        if (!((parents[i] == i) && (depth[i] == 0))) {
-          std::cout << "Source wrong";
-          correct = false;
-        }
-        continue;
-      }
-      bool parent_found = false;
-      for (int64_t j = graph->rowptr[i]; j < graph->rowptr[i + 1]; j++) {
-        if (graph->col[j] == parents[i]) {
-          vidType parent = graph->col[j];
-          // Check if parent has correct depth
-          if (depth[parent] != depth[i] - 1) {
-            std::cout << "Wrong depth of child " + std::to_string(i) +
-                             " (parent " + std::to_string(parent) +
-                             " with depth " + std::to_string(depth[parent])
-                      << ")" << std::endl;
-            correct = false;
-          }
-          parent_found = true;
-          break;
-        }
-      }
-      if (!parent_found) {
-        std::cout << "Couldn't find edge from " << parents[i] << " to "
-                  << std::to_string(i) << std::endl;
-        correct = false;
+  if (invalid != 0) {
+    std::cout << invalid << " parents are not vertices" << std::endl;
+    return false;
+  }
+
+  bool changed = true;
+  for (int round = 0; changed && round <= 32; round++) {
+    changed = false;
+#pragma omp parallel for reduction(|| : changed) schedule(static)
+    for (vidType v = 0; v < graph->N; v++) {
+      vidType a = ancestor[v];
+      if (steps[v] == UNREACHED || a == source || steps[a] == UNREACHED) {
+        next_ancestor[v] = a;
+        next_steps[v] = steps[v];
+      } else {
+        next_ancestor[v] = ancestor[a];
+        next_steps[v] = steps[v] + steps[a];
+        changed = true;
       }
-      // Check if parent = -1 and parent = -1
-    } else if (depth[i] != parents[i]) {
-      std::cout << "Reachability mismatch" << std::endl;
-      correct = false;
     }
+    std::swap(ancestor, next_ancestor);
+    std::swap(steps, next_steps);
   }
-  return correct;
-}
\ No newline at end of file
+
+  std::vector<weight_type> depth(graph->N);
+  uint64_t detached = 0;
+#pragma omp parallel for reduction(+ : detached) schedule(static)
+  for (vidType v = 0; v < graph->N; v++) {
+    if (steps[v] == UNREACHED) {
+      depth[v] = UNREACHED;
+    } else if (ancestor[v] != source) {
+      detached++;
+      depth[v] = UNREACHED;
+    } else {
+      depth[v] = steps[v];
+    }
+  }
+  bool correct = detached == 0;
+  if (!correct) {
+    std::cout << detached << " vertices have parents that do not lead to the "
+              << "source" << std::endl;
+  }
+  return check_levels(source, depth.data(), parents) && correct;
+}
+
+template class BFS_Impl<uint32_t>;
+template class BFS_Impl<uint64_t>;
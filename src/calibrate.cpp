@@ -0,0 +1,131 @@
+#include "calibrate.hpp"
+#include "tuning.hpp"
+#include <limits>
+#include <omp.h>
+#include <unistd.h>
+
+static const uint32_t alpha_candidates[] = {1, 2, 4, 8, 16, 32, 64};
+static const uint32_t beta_candidates[] = {6, 12, 24, 48, 96, 192};
+
+// Thresholds depend on the machine as much as on the graph
+static std::string host_name() {
+  char name[256] = {};
+  gethostname(name, sizeof(name) - 1);
+  return name;
+}
+
+template <typename eidType>
+const char *thresholds_key(const BFS_Impl<eidType> *bfs) {
+  if (dynamic_cast<const Bitmap<eidType> *>(bfs) != nullptr) {
+    return "thresholds.bitmap";
+  } else if (dynamic_cast<const MergedCSR<eidType> *>(bfs) != nullptr) {
+    return "thresholds.merged_csr";
+  } else if (dynamic_cast<const MergedCSR_Compressed<eidType> *>(bfs) !=
+             nullptr) {
+    return "thresholds.merged_csr_compressed";
+  } else if (dynamic_cast<const Classic<eidType> *>(bfs) != nullptr) {
+    return "thresholds.classic";
+  } else if (dynamic_cast<const Sparse<eidType> *>(bfs) != nullptr) {
+    return "thresholds.sparse";
+  }
+  return nullptr;
+}
+
+template <typename eidType>
+bool load_thresholds(BFS_Impl<eidType> *bfs, const std::string &schema_path) {
+  const char *key = thresholds_key(bfs);
+  if (key == nullptr) {
+    return false;
+  }
+  nlohmann::json entry =
+      read_tuning(schema_path, key, bfs->graph->N, bfs->graph->M);
+  if (!entry.is_object() || entry.value("host", "") != host_name() ||
+      entry.value("threads", 0) != omp_get_max_threads()) {
+    return false;
+  }
+  bfs->alpha = entry.value("alpha", ALPHA);
+  bfs->beta = entry.value("beta", BETA);
+  return true;
+}
+
+// Sum over the sources of the best of two runs
+template <typename eidType>
+static double time_sources(BFS_Impl<eidType> *bfs,
+                           const std::vector<vidType> &sources,
+                           weight_type *distances) {
+  double total = 0;
+  for (vidType source : sources) {
+    double best = std::numeric_limits<double>::max();
+    for (int run = 0; run < 2; run++) {
+      std::fill_n(distances, bfs->graph->N,
+                  std::numeric_limits<weight_type>::max());
+      double t_start = omp_get_wtime();
+      bfs->BFS(source, distances);
+      best = std::min(best, omp_get_wtime() - t_start);
+    }
+    total += best;
+  }
+  return total;
+}
+
+template <typename eidType>
+void calibrate_thresholds(BFS_Impl<eidType> *bfs,
+                          const std::string &schema_path,
+                          const std::vector<vidType> &sources) {
+  const char *key = thresholds_key(bfs);
+  if (key == nullptr) {
+    printf("Calibration: the engine does not switch direction\n");
+    return;
+  }
+  weight_type *distances = new weight_type[bfs->graph->N];
+  double default_time = 0;
+  double best_time = std::numeric_limits<double>::max();
+  uint32_t best_alpha = ALPHA, best_beta = BETA;
+  bfs->beta = BETA;
+  for (uint32_t alpha : alpha_candidates) {
+    bfs->alpha = alpha;
+    double time = time_sources(bfs, sources, distances);
+    if (alpha == ALPHA) {
+      default_time = time;
+    }
+    if (time < best_time) {
+      best_time = time;
+      best_alpha = alpha;
+    }
+  }
+  bfs->alpha = best_alpha;
+  for (uint32_t beta : beta_candidates) {
+    if (beta == BETA) {
+      continue; // Already timed with the best alpha
+    }
+    bfs->beta = beta;
+    double time = time_sources(bfs, sources, distances);
+    if (time < best_time) {
+      best_time = time;
+      best_beta = beta;
+    }
+  }
+  bfs->beta = best_beta;
+  delete[] distances;
+
+  printf("Calibration: alpha %u, beta %u (%.6f s vs %.6f s with alpha %u, "
+         "beta %u)\n",
+         best_alpha, best_beta, best_time, default_time, ALPHA, BETA);
+  write_tuning(schema_path, key,
+               {{"alpha", best_alpha},
+                {"beta", best_beta},
+                {"time_s", best_time},
+                {"default_time_s", default_time},
+                {"host", host_name()},
+                {"threads", omp_get_max_threads()}},
+               bfs->graph->N, bfs->graph->M);
+}
+
+template const char *thresholds_key(const BFS_Impl<uint32_t> *);
+template const char *thresholds_key(const BFS_Impl<uint64_t> *);
+template bool load_thresholds(BFS_Impl<uint32_t> *, const std::string &);
+template bool load_thresholds(BFS_Impl<uint64_t> *, const std::string &);
+template void calibrate_thresholds(BFS_Impl<uint32_t> *, const std::string &,
+                                   const std::vector<vidType> &);
+template void calibrate_thresholds(BFS_Impl<uint64_t> *, const std::string &,
+                                   const std::vector<vidType> &);
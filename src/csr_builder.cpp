@@ -0,0 +1,199 @@
+#include "graph.hpp"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <omp.h>
+#include <stdexcept>
+
+// In-place inclusive prefix sum: each thread scans its chunk, then adds the
+// total of the chunks before it
+static void prefix_sum(uint64_t *values, uint64_t n) {
+  std::vector<uint64_t> totals(omp_get_max_threads() + 1, 0);
+#pragma omp parallel
+  {
+    int thread = omp_get_thread_num();
+    int num_threads = omp_get_num_threads();
+    uint64_t first = n * thread / num_threads;
+    uint64_t last = n * (thread + 1) / num_threads;
+    for (uint64_t i = first + 1; i < last; i++) {
+      values[i] += values[i - 1];
+    }
+    totals[thread + 1] = last > first ? values[last - 1] : 0;
+#pragma omp barrier
+#pragma omp single
+    for (int t = 1; t <= num_threads; t++) {
+      totals[t] += totals[t - 1];
+    }
+    for (uint64_t i = first; i < last; i++) {
+      values[i] += totals[thread];
+    }
+  }
+}
+
+// Edges are scattered as T: the neighbor alone, or for weighted graphs the
+// neighbor in the high half and the weight in the low half, so that sorting a
+// row orders it by neighbor and then by weight
+template <typename T> static inline vidType neighbor_of(T edge) {
+  if constexpr (std::is_same_v<T, vidType>) {
+    return edge;
+  } else {
+    return edge >> 32;
+  }
+}
+
+template <typename eidType>
+void Graph<eidType>::build_csr(const int64_t *src, const int64_t *dst,
+                               uint64_t num_edges, uint64_t num_vertices,
+                               bool symmetrize, bool drop_self_loops,
+                               const wgtType *edge_weights) {
+  if (edge_weights == nullptr) {
+    build_rows<vidType>(src, dst, nullptr, num_edges, num_vertices, symmetrize,
+                        drop_self_loops);
+  } else {
+    build_rows<uint64_t>(src, dst, edge_weights, num_edges, num_vertices,
+                         symmetrize, drop_self_loops);
+  }
+}
+
+template <typename eidType>
+template <typename T>
+void Graph<eidType>::build_rows(const int64_t *src, const int64_t *dst,
+                                const wgtType *edge_weights, uint64_t num_edges,
+                                uint64_t num_vertices, bool symmetrize,
+                                bool drop_self_loops) {
+  if (num_vertices == 0) {
+    int64_t max_id = -1;
+#pragma omp parallel for reduction(max : max_id) schedule(static)
+    for (uint64_t i = 0; i < num_edges; i++) {
+      max_id = std::max({max_id, src[i], dst[i]});
+    }
+    num_vertices = max_id + 1;
+  }
+  const uint64_t n = num_vertices;
+
+  // Degrees, counted at offsets[v + 1]
+  std::unique_ptr<uint64_t[]> offsets(new uint64_t[n + 1]);
+#pragma omp parallel for schedule(static)
+  for (uint64_t v = 0; v <= n; v++) {
+    offsets[v] = 0;
+  }
+  bool out_of_range = false;
+#pragma omp parallel for reduction(|| : out_of_range) schedule(static)
+  for (uint64_t i = 0; i < num_edges; i++) {
+    if (src[i] < 0 || dst[i] < 0 || (uint64_t)src[i] >= n ||
+        (uint64_t)dst[i] >= n) {
+      out_of_range = true;
+      continue;
+    }
+    if (src[i] == dst[i] && drop_self_loops) {
+      continue;
+    }
+    std::atomic_ref<uint64_t>(offsets[src[i] + 1])
+        .fetch_add(1, std::memory_order_relaxed);
+    if (symmetrize && src[i] != dst[i]) {
+      std::atomic_ref<uint64_t>(offsets[dst[i] + 1])
+          .fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  if (out_of_range) {
+    throw std::runtime_error("Error: edge endpoint out of range");
+  }
+  prefix_sum(offsets.get(), n + 1);
+
+  // Scatter the edges to their rows, in any order within a row
+  std::unique_ptr<uint64_t[]> cursor(new uint64_t[n]);
+#pragma omp parallel for schedule(static)
+  for (uint64_t v = 0; v < n; v++) {
+    cursor[v] = offsets[v];
+  }
+  T *edges = large_new<T>(offsets[n]);
+  auto edge = [&](int64_t neighbor, uint64_t i) -> T {
+    if constexpr (std::is_same_v<T, vidType>) {
+      return neighbor;
+    } else {
+      return ((uint64_t)neighbor << 32) | edge_weights[i];
+    }
+  };
+#pragma omp parallel for schedule(static)
+  for (uint64_t i = 0; i < num_edges; i++) {
+    if (src[i] == dst[i] && drop_self_loops) {
+      continue;
+    }
+    edges[std::atomic_ref<uint64_t>(cursor[src[i]])
+              .fetch_add(1, std::memory_order_relaxed)] = edge(dst[i], i);
+    if (symmetrize && src[i] != dst[i]) {
+      edges[std::atomic_ref<uint64_t>(cursor[dst[i]])
+                .fetch_add(1, std::memory_order_relaxed)] = edge(src[i], i);
+    }
+  }
+
+  // Sort and deduplicate each row, keeping the lightest of parallel edges;
+  // cursor becomes the deduplicated degree
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (uint64_t v = 0; v < n; v++) {
+    std::sort(edges + offsets[v], edges + offsets[v + 1]);
+    cursor[v] = std::unique(edges + offsets[v], edges + offsets[v + 1],
+                            [](T a, T b) {
+                              return neighbor_of(a) == neighbor_of(b);
+                            }) -
+                (edges + offsets[v]);
+  }
+  uint64_t num_unique = 0;
+#pragma omp parallel for reduction(+ : num_unique) schedule(static)
+  for (uint64_t v = 0; v < n; v++) {
+    num_unique += cursor[v];
+  }
+  if (num_unique > std::numeric_limits<eidType>::max()) {
+    large_delete(edges);
+    throw std::runtime_error("Error: graph needs 64-bit edge indices");
+  }
+
+  release_storage();
+  N = n;
+  M = num_unique;
+  if constexpr (std::is_same_v<T, vidType>) {
+    if (num_unique == offsets[n]) {
+      // No duplicates: the scattered rows are already in place
+      rowptr = large_new<eidType>(N + 1);
+#pragma omp parallel for schedule(static)
+      for (uint64_t v = 0; v <= N; v++) {
+        rowptr[v] = offsets[v];
+      }
+      col = edges;
+      return;
+    }
+  }
+  std::unique_ptr<uint64_t[]> unique_offsets(new uint64_t[N + 1]);
+  unique_offsets[0] = 0;
+#pragma omp parallel for schedule(static)
+  for (uint64_t v = 0; v < N; v++) {
+    unique_offsets[v + 1] = cursor[v];
+  }
+  prefix_sum(unique_offsets.get(), N + 1);
+  rowptr = large_new<eidType>(N + 1);
+  col = large_new<vidType>(M);
+  if (edge_weights != nullptr) {
+    weights = large_new<wgtType>(M);
+  }
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (uint64_t v = 0; v < N; v++) {
+    rowptr[v] = unique_offsets[v];
+    for (uint64_t j = 0; j < cursor[v]; j++) {
+      T e = edges[offsets[v] + j];
+      col[unique_offsets[v] + j] = neighbor_of(e);
+      if constexpr (!std::is_same_v<T, vidType>) {
+        weights[unique_offsets[v] + j] = (wgtType)e;
+      }
+    }
+  }
+  rowptr[N] = M;
+  large_delete(edges);
+}
+
+template void Graph<uint32_t>::build_csr(const int64_t *, const int64_t *,
+                                         uint64_t, uint64_t, bool, bool,
+                                         const wgtType *);
+template void Graph<uint64_t>::build_csr(const int64_t *, const int64_t *,
+                                         uint64_t, uint64_t, bool, bool,
+                                         const wgtType *);
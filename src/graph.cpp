@@ -1,17 +1,41 @@
 #include "graph.hpp"
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 #include <fstream>
+#include <limits>
+#include <omp.h>
+#include <fcntl.h>
 #include <random>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include "inputschema.cpp"
 
-Graph::Graph(eidType *rowptr, vidType *col, uint64_t N, uint64_t M)
-    : rowptr(rowptr), col(col), N(N), M(M) {}
+// Binary datasets hold N, M, rowptr (N + 1 64-bit offsets), col (M 32-bit
+// neighbors) and, for weighted graphs, M 32-bit weights. Returns true if a
+// file of size bytes holds all of them. N and M are read from the file, so
+// each array is checked against the bytes left, which cannot overflow
+static bool file_holds(uint64_t size, uint64_t N, uint64_t M, bool weighted) {
+  if (size < 2 * sizeof(uint64_t)) {
+    return false;
+  }
+  size -= 2 * sizeof(uint64_t);
+  if (N >= size / sizeof(uint64_t)) {
+    return false;
+  }
+  size -= sizeof(uint64_t) * (N + 1);
+  if (M > size / sizeof(vidType)) {
+    return false;
+  }
+  size -= sizeof(vidType) * M;
+  return !weighted || M <= size / sizeof(wgtType);
+}
 
-Graph::Graph(std::string &schema_path) {
+// Parse the JSON schema of a dataset
+static quicktype::Inputschema read_schema(std::string &schema_path) {
   nlohmann::json j;
   std::ifstream in(schema_path);
   if (!in.is_open()) {
@@ -20,16 +44,69 @@ Graph::Graph(std::string &schema_path) {
   in >> j;
   quicktype::Inputschema data;
   quicktype::from_json(j, data);
+  return data;
+}
+
+bool needs_64bit_index(std::string &schema_path) {
+  quicktype::Inputschema data = read_schema(schema_path);
+  uint64_t N = 0, M = 0;
+  bool weighted = false;
+  if (data.graph.data_file_format.has_value()) {
+    // Read N and M from the header of the binary file
+    std::string path = "datasets/" + data.graph.filename.value();
+    std::ifstream s{path, s.in | s.binary | s.ate};
+    if (!s.is_open()) {
+      throw std::runtime_error("Error: Unable to open file " + path);
+    }
+    uint64_t size = s.tellg();
+    s.seekg(0);
+    s.read((char *)&N, sizeof(decltype(N)));
+    s.read((char *)&M, sizeof(decltype(M)));
+    weighted = file_holds(size, N, M, true);
+  } else if (data.graph.coo_format.has_value()) {
+    std::vector<int64_t> &row = data.graph.row.value();
+    std::vector<int64_t> &col = data.graph.col.value();
+    for (size_t i = 0; i < row.size(); i++) {
+      N = std::max<uint64_t>(N, std::max(row[i], col[i]) + 1);
+    }
+    M = row.size();
+    weighted = data.graph.weight.has_value();
+  } else if (data.graph.random_generated_graph.has_value()) {
+    N = data.graph.num_vertices.value() + 1;
+    M = 2 * N * data.graph.num_edges_per_vertex.value();
+  }
+  // Keep the largest value free, as it is used as a sentinel. The weighted
+  // layout of DeltaStepping has 2M + 2N entries
+  uint64_t layout = std::max(M + 3 * N, weighted ? 2 * M + 2 * N : 0);
+  return layout >= std::numeric_limits<uint32_t>::max();
+}
+
+// Refuse to silently truncate edge indices that do not fit in eidType
+template <typename eidType>
+static void check_index_width(uint64_t num_edges, std::string &path) {
+  if (num_edges > std::numeric_limits<eidType>::max()) {
+    throw std::runtime_error("Error: " + path +
+                             " needs 64-bit edge indices");
+  }
+}
+
+template <typename eidType>
+Graph<eidType>::Graph(std::string &schema_path, LoadMode load_mode) {
+  quicktype::Inputschema data = read_schema(schema_path);
+  if (data.sources.has_value()) {
+    sources.assign(data.sources->begin(), data.sources->end());
+  }
   if (data.graph.data_file_format.has_value()) {
     assert(data.graph.filename.has_value() &&
             data.graph.file_format.has_value());
     assert(data.graph.file_format.value() ==
             "binary");
-    construct_from_file(data.graph.filename.value());
+    construct_from_file(data.graph.filename.value(), load_mode);
   } else if (data.graph.coo_format.has_value()) {
     assert(data.graph.row.has_value() && data.graph.col.has_value()
             && "COO values missing.");
-    construct_from_coo(data.graph.row.value(), data.graph.col.value());
+    construct_from_coo(data.graph.row.value(), data.graph.col.value(),
+                       data.graph.weight);
   } else if (data.graph.random_generated_graph.has_value()) {
     generate_random_graph(data.graph.num_vertices.value(),
                           data.graph.num_edges_per_vertex.value());
@@ -38,101 +115,192 @@ Graph::Graph(std::string &schema_path) {
   }
 }
 
-Graph::~Graph() {
-  delete[] rowptr;
-  delete[] col;
-}
+template <typename eidType> Graph<eidType>::~Graph() { release_storage(); }
 
-void Graph::construct_from_coo(std::vector<int64_t> &input_row,
-                                   std::vector<int64_t> &input_col) {
-  // convert COO form to CSR format.
-  N = input_row[0];
-  for (int64_t i = input_row.size(); --i >= 0;) {
-    if (input_row[i] + 1 > N) {
-      N = input_row[i] + 1;
-    }
+template <typename eidType> void Graph<eidType>::release_storage() {
+  if (!rowptr_mapped) {
+    large_delete(rowptr);
   }
-  M = input_col.size();
+  if (mapping != nullptr) {
+    munmap(mapping, mapping_size);
+    mapping = nullptr;
+  } else {
+    large_delete(col);
+    large_delete(weights);
+  }
+  rowptr_mapped = false;
+  rowptr = nullptr;
+  col = nullptr;
+  weights = nullptr;
+}
+
+template <typename eidType>
+void Graph<eidType>::construct_from_coo(
+    std::vector<int64_t> &input_row, std::vector<int64_t> &input_col,
+    std::optional<std::vector<double>> &input_weight) {
   assert(input_col.size() == input_row.size() &&
          "In COO format col and row must have the same lengths");
-  rowptr = new eidType[N + 1]();
-  col = new vidType[M]();
-
-  for (size_t i = 0; i < input_row.size(); i++) {
-    vidType src = input_row[i];
-    vidType dst = input_col[i];
-    col[i] = dst;
-    rowptr[src + 1] = i + 1;
+  if (!input_weight.has_value()) {
+    build_csr(input_row.data(), input_col.data(), input_row.size());
+    return;
+  }
+  assert(input_weight->size() == input_row.size() &&
+         "In COO format weight and row must have the same lengths");
+  std::vector<wgtType> edge_weights(input_weight->size());
+  for (size_t i = 0; i < edge_weights.size(); i++) {
+    edge_weights[i] = std::llround((*input_weight)[i]);
   }
+  build_csr(input_row.data(), input_col.data(), input_row.size(), 0, false,
+            false, edge_weights.data());
 }
 
-void Graph::construct_from_file(std::string &filename) {
+template <typename eidType>
+void Graph<eidType>::construct_from_file(std::string &filename,
+                                         LoadMode load_mode) {
   std::string path = "datasets/" + filename;
-  std::ifstream s{path, s.in | s.binary};
+  dataset_path = path;
+  if (load_mode == LoadMode::MMAP || load_mode == LoadMode::MMAP_POPULATE) {
+    map_file(path, load_mode == LoadMode::MMAP_POPULATE);
+    return;
+  }
+  std::ifstream s{path, s.in | s.binary | s.ate};
   if (!s.is_open()) {
     throw std::runtime_error("Error: Unable to open file " + path);
   }
+  uint64_t size = s.tellg();
+  s.seekg(0);
 
   s.read((char *)&N, sizeof(decltype(N)));
   s.read((char *)&M, sizeof(decltype(M)));
+  if (!s || !file_holds(size, N, M, false)) {
+    throw std::runtime_error("Error: Truncated file " + path);
+  }
+  if (load_mode == LoadMode::HEADER) {
+    check_index_width<eidType>(M, path);
+    return;
+  }
 
-  rowptr = new eidType[N + 1];
-  col = new vidType[M];
-
-  uint64_t *temp_rowptr = new uint64_t[N + 1];
-  s.read((char *)temp_rowptr, sizeof(uint64_t) * (N + 1));
+  // Checked before anything is allocated, since the destructor does not run
+  // when the constructor throws
+  std::vector<uint64_t> temp_rowptr(N + 1);
+  s.read((char *)temp_rowptr.data(), sizeof(uint64_t) * (N + 1));
+  check_index_width<eidType>(temp_rowptr[N], path);
+  rowptr = large_new<eidType>(N + 1);
+  col = large_new<vidType>(M);
   // Convert to eidType from uint64_t
+#pragma omp parallel for schedule(static)
   for (uint64_t i = 0; i <= N; i++) {
     rowptr[i] = static_cast<eidType>(temp_rowptr[i]);
   }
-  delete[] temp_rowptr;
   s.read((char *)col, sizeof(uint32_t) * M);
-  
+  if (file_holds(size, N, M, true)) {
+    weights = large_new<wgtType>(M);
+    s.read((char *)weights, sizeof(wgtType) * M);
+  }
+
   s.close();
 }
 
-void Graph::generate_random_graph(int64_t num_vertices,
+// Map the dataset file in memory. col is used in place, and so is rowptr if
+// eidType is 64-bit. Otherwise rowptr is converted to eidType in parallel
+template <typename eidType>
+void Graph<eidType>::map_file(std::string &path, bool populate) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw std::runtime_error("Error: Unable to open file " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("Error: Unable to stat file " + path);
+  }
+  mapping_size = st.st_size;
+  // Also refuses empty files, which cannot be mapped
+  if (mapping_size < 2 * sizeof(uint64_t)) {
+    close(fd);
+    throw std::runtime_error("Error: Truncated file " + path);
+  }
+  int flags = MAP_PRIVATE | (populate ? MAP_POPULATE : 0);
+  mapping = mmap(nullptr, mapping_size, PROT_READ, flags, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    mapping = nullptr;
+    throw std::runtime_error("Error: Unable to map file " + path);
+  }
+
+  const uint64_t *header = static_cast<const uint64_t *>(mapping);
+  N = header[0];
+  M = header[1];
+  const uint64_t *file_rowptr = header + 2;
+  // The destructor does not run when the constructor throws, so the mapping
+  // is released here
+  if (!file_holds(mapping_size, N, M, false)) {
+    munmap(mapping, mapping_size);
+    mapping = nullptr;
+    throw std::runtime_error("Error: Truncated file " + path);
+  }
+  col = (vidType *)(file_rowptr + N + 1);
+  if (file_holds(mapping_size, N, M, true)) {
+    weights = (wgtType *)(col + M);
+  }
+  if (!populate) {
+    // Start reading the neighbor lists in the background
+    madvise(mapping, mapping_size, MADV_WILLNEED);
+  }
+
+  if constexpr (std::is_same_v<eidType, uint64_t>) {
+    rowptr = const_cast<eidType *>(file_rowptr);
+    rowptr_mapped = true;
+    return;
+  }
+  try {
+    check_index_width<eidType>(file_rowptr[N], path);
+  } catch (const std::runtime_error &) {
+    munmap(mapping, mapping_size);
+    mapping = nullptr;
+    col = nullptr;
+    weights = nullptr;
+    throw;
+  }
+  rowptr = large_new<eidType>(N + 1);
+#pragma omp parallel for schedule(static)
+  for (uint64_t i = 0; i <= N; i++) {
+    rowptr[i] = static_cast<eidType>(file_rowptr[i]);
+  }
+}
+
+// Uniform random edges, each drawn by a thread with its own generator, then
+// symmetrized without self-loops
+template <typename eidType>
+void Graph<eidType>::generate_random_graph(int64_t num_vertices,
                                       int64_t num_edges_per_vertex) {
   std::random_device r;
-  std::default_random_engine el(r());
-  std::uniform_int_distribution<uint64_t> uniform_dist(0, num_vertices);
+  uint64_t seed = ((uint64_t)r() << 32) | r();
   int64_t num_edges = num_vertices * num_edges_per_vertex;
-  std::vector<std::tuple<int64_t, int64_t>> edges;
-  edges.reserve(num_edges);
-  for (int64_t i = 0; i < num_edges; i++) {
-    uint64_t src = uniform_dist(el);
-    uint64_t dst = uniform_dist(el);
-    if (src == dst)
-      continue;
-    edges.push_back(std::make_tuple(src, dst));
-    edges.push_back(std::make_tuple(dst, src));
-  }
-  std::sort(edges.begin(), edges.end());
-  std::vector<std::tuple<int64_t, int64_t>> filtered_edges;
-  filtered_edges.reserve(edges.size());
-  for (int64_t i = 0; i < edges.size(); i++) {
-    if (i == 0 || std::get<0>(edges[i]) != std::get<0>(edges[i - 1]) ||
-        std::get<1>(edges[i]) != std::get<1>(edges[i - 1])) {
-      filtered_edges.push_back(edges[i]);
+  std::vector<int64_t> row(num_edges);
+  std::vector<int64_t> col(num_edges);
+#pragma omp parallel
+  {
+    std::default_random_engine el(seed + omp_get_thread_num());
+    std::uniform_int_distribution<int64_t> uniform_dist(0, num_vertices);
+#pragma omp for schedule(static)
+    for (int64_t i = 0; i < num_edges; i++) {
+      row[i] = uniform_dist(el);
+      col[i] = uniform_dist(el);
     }
   }
-  std::vector<int64_t> row(filtered_edges.size());
-  std::vector<int64_t> col(filtered_edges.size());
-  for (int64_t i = 0; i < filtered_edges.size(); i++) {
-    row[i] = std::get<0>(filtered_edges[i]);
-    col[i] = std::get<1>(filtered_edges[i]);
-  }
-  construct_from_coo(row, col);
+  build_csr(row.data(), col.data(), num_edges, num_vertices + 1, true, true);
 }
 
-void Graph::print_graph() {
+template <typename eidType>
+void Graph<eidType>::print_graph() {
   // Print the number of vertices (N) and edges (M) in the graph
   printf("Number of vertices (N): %llu\n", N);
   printf("Number of edges (M): %llu\n", M);
   // Print the rowptr array of the graph
   printf("Rowptr: ");
   for (size_t i = 0; i < 10; ++i) {
-    printf("%u ", rowptr[i]);
+    printf("%llu ", (unsigned long long)rowptr[i]);
   }
   printf("\n");
 
@@ -142,4 +310,7 @@ void Graph::print_graph() {
     printf("%u ", col[i]);
   }
   printf("\n");
-}
\ No newline at end of file
+}
+
+template class Graph<uint32_t>;
+template class Graph<uint64_t>;
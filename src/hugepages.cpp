@@ -0,0 +1,141 @@
+#include "hugepages.hpp"
+#include "numa_placement.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << 26)
+#endif
+
+typedef enum { BACKING_BASE, BACKING_THP, BACKING_HUGETLB } Backing;
+
+static const char *backing_names[] = {"base pages", "THP", "hugetlbfs"};
+
+struct Allocation {
+  size_t bytes; // Mapped bytes
+  Backing backing;
+};
+
+static PageMode page_mode = PAGES_THP;
+static std::mutex allocations_mutex;
+static std::map<uintptr_t, Allocation> allocations;
+static std::atomic<bool> hugetlb_warned = false;
+
+void set_page_mode(PageMode mode) { page_mode = mode; }
+
+static void *map_anonymous(size_t bytes, int flags) {
+  void *ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+  return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+// Map bytes at a 2 MB boundary: over-allocate, then trim both ends
+static void *map_aligned(size_t bytes) {
+  uint8_t *ptr = (uint8_t *)map_anonymous(bytes + HUGE_PAGE_SIZE, 0);
+  if (ptr == nullptr) {
+    return nullptr;
+  }
+  uintptr_t aligned =
+      ((uintptr_t)ptr + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+  size_t head = aligned - (uintptr_t)ptr;
+  if (head > 0) {
+    munmap(ptr, head);
+  }
+  munmap((void *)(aligned + bytes), HUGE_PAGE_SIZE - head);
+  return (void *)aligned;
+}
+
+void *large_alloc(size_t bytes) {
+  Allocation allocation = {bytes, BACKING_BASE};
+  void *ptr = nullptr;
+  if (page_mode == PAGES_DEFAULT || bytes < HUGE_PAGE_SIZE) {
+    allocation.bytes = std::max<size_t>(bytes, 1);
+    ptr = map_anonymous(allocation.bytes, 0);
+  } else {
+    allocation.bytes = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    if (page_mode == PAGES_HUGETLB) {
+      ptr = map_anonymous(allocation.bytes, MAP_HUGETLB | MAP_HUGE_2MB);
+      allocation.backing = BACKING_HUGETLB;
+      // Allocations may run concurrently, only one of them warns
+      if (ptr == nullptr && !hugetlb_warned.exchange(true)) {
+        fprintf(stderr, "Warning: hugetlbfs pool exhausted, using THP\n");
+      }
+    }
+    if (ptr == nullptr) {
+      ptr = map_aligned(allocation.bytes);
+      allocation.backing = BACKING_THP;
+      if (ptr != nullptr) {
+        madvise(ptr, allocation.bytes, MADV_HUGEPAGE);
+      }
+    }
+  }
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  numa_place(ptr, bytes);
+  std::lock_guard<std::mutex> lock(allocations_mutex);
+  allocations[(uintptr_t)ptr] = allocation;
+  return ptr;
+}
+
+void large_free(void *ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(allocations_mutex);
+  auto it = allocations.find((uintptr_t)ptr);
+  // Only arrays from large_alloc may be freed here, anything else would leak
+  if (it == allocations.end()) {
+    fprintf(stderr, "Warning: large_free of unknown pointer %p\n", ptr);
+    assert(false && "large_free of a pointer not from large_alloc");
+    return;
+  }
+  munmap(ptr, it->second.bytes);
+  allocations.erase(it);
+}
+
+// Bytes backed by transparent huge pages in the mappings madvised with
+// MADV_HUGEPAGE ('hg' flag in /proc/self/smaps), which are the THP arrays
+static size_t anon_huge_bytes() {
+  std::ifstream smaps("/proc/self/smaps");
+  std::string line;
+  size_t huge = 0, total = 0;
+  while (std::getline(smaps, line)) {
+    if (line.rfind("AnonHugePages:", 0) == 0) {
+      std::istringstream(line.substr(14)) >> huge;
+    } else if (line.rfind("VmFlags:", 0) == 0) {
+      if ((line + " ").find(" hg ") != std::string::npos) {
+        total += huge << 10;
+      }
+      huge = 0;
+    }
+  }
+  return total;
+}
+
+void page_report(FILE *out) {
+  std::lock_guard<std::mutex> lock(allocations_mutex);
+  size_t bytes[3] = {};
+  for (const auto &[address, allocation] : allocations) {
+    bytes[allocation.backing] += allocation.bytes;
+  }
+  fprintf(out, "Pages:");
+  for (int b = BACKING_BASE; b <= BACKING_HUGETLB; b++) {
+    fprintf(out, "%s %.1f MB on %s", b > BACKING_BASE ? "," : "",
+            bytes[b] / 1048576.0, backing_names[b]);
+    if (b == BACKING_THP && bytes[b] > 0) {
+      fprintf(out, " (%.1f MB huge)", anon_huge_bytes() / 1048576.0);
+    }
+  }
+  fprintf(out, "\n");
+}
@@ -0,0 +1,134 @@
+#include "graph.hpp"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+#define UNREACHED std::numeric_limits<weight_type>::max()
+
+template <typename eidType>
+Bidirectional<eidType>::Bidirectional(Graph<eidType> *graph) : graph(graph) {
+  for (Side &side : sides) {
+    side.depth = large_new<weight_type>(graph->N);
+#pragma omp parallel for schedule(static)
+    for (vidType i = 0; i < graph->N; i++) {
+      side.depth[i] = UNREACHED;
+    }
+  }
+}
+
+template <typename eidType>
+Bidirectional<eidType>::~Bidirectional() {
+  for (Side &side : sides) {
+    large_delete(side.depth);
+  }
+}
+
+// Set the depth of v if it is unreached, so that only one thread adds it to
+// the frontier
+static inline bool claim(weight_type *depth, vidType v, weight_type level) {
+  std::atomic_ref<weight_type> v_depth(depth[v]);
+  weight_type unreached = UNREACHED;
+  return v_depth.load(std::memory_order_relaxed) == unreached &&
+         v_depth.compare_exchange_strong(unreached, level,
+                                         std::memory_order_relaxed);
+}
+
+// Expand the frontier of side by one level. A neighbor already reached by the
+// other side closes a path, and the shortest of them is returned (the largest
+// value if there is none). The searches had not met before this level, so
+// every shortest path crosses it and the shortest candidate is the distance
+template <typename eidType>
+weight_type Bidirectional<eidType>::expand(Side &side, const Side &other) {
+  PERF_REGION("Bidirectional::expand");
+  TRACE_LEVEL_BEGIN(TOP_DOWN, side.reached.size() - side.begin, side.edges,
+                    TRACE_UNKNOWN);
+  size_t end = side.reached.size();
+  weight_type level = side.level + 1;
+  weight_type best = UNREACHED;
+  eidType edges_frontier = 0;
+  heavy.clear();
+#pragma omp parallel if (side.edges > 150)
+  {
+    std::vector<vidType> &local_reached = side.reached.local();
+    // Takes the reduction variables, which are private to each loop
+    auto visit = [&](eidType first, eidType last, eidType &edges,
+                     weight_type &shortest) {
+      for (eidType i = first; i < last; i++) {
+        vidType neighbor = graph->col[i];
+        if (other.depth[neighbor] != UNREACHED) {
+          shortest = std::min(shortest, level + other.depth[neighbor]);
+        } else if (claim(side.depth, neighbor, level)) {
+          local_reached.push_back(neighbor);
+          edges += graph->rowptr[neighbor + 1] - graph->rowptr[neighbor];
+        }
+      }
+    };
+    std::vector<EdgeChunk<eidType>> &local_heavy = heavy.local();
+#pragma omp for reduction(+ : edges_frontier) reduction(min : best)           \
+    schedule(static)
+    for (size_t f = side.begin; f < end; f++) {
+      vidType v = side.reached[f];
+      if (graph->rowptr[v + 1] - graph->rowptr[v] > HEAVY_DEGREE) {
+        split_edges(local_heavy, graph->rowptr[v], graph->rowptr[v + 1]);
+      } else {
+        visit(graph->rowptr[v], graph->rowptr[v + 1], edges_frontier, best);
+      }
+    }
+    heavy.flush();
+#pragma omp for reduction(+ : edges_frontier) reduction(min : best)           \
+    schedule(dynamic, 1)
+    for (const auto &chunk : heavy) {
+      visit(chunk.begin, chunk.end, edges_frontier, best);
+    }
+    side.reached.flush();
+  }
+  side.begin = end;
+  side.level = level;
+  side.edges = edges_frontier;
+  TRACE_LEVEL_END();
+  return best;
+}
+
+template <typename eidType>
+void Bidirectional<eidType>::reset() {
+  for (Side &side : sides) {
+#pragma omp parallel for schedule(static) if (side.reached.size() > 1000)
+    for (const auto &v : side.reached) {
+      side.depth[v] = UNREACHED;
+    }
+    side.reached.clear();
+  }
+}
+
+template <typename eidType>
+weight_type Bidirectional<eidType>::distance(vidType source, vidType target) {
+  PERF_REGION("Bidirectional::BFS");
+  TRACE_RUN("Bidirectional", source);
+  if (source == target) {
+    return 0;
+  }
+  reset();
+  vidType endpoints[2] = {source, target};
+  for (int s = 0; s < 2; s++) {
+    Side &side = sides[s];
+    vidType v = endpoints[s];
+    side.reached.push_back(v);
+    side.depth[v] = 0;
+    side.begin = 0;
+    side.level = 0;
+    side.edges = graph->rowptr[v + 1] - graph->rowptr[v];
+  }
+  // An empty frontier means that its endpoint's component has been exhausted
+  while (sides[0].begin < sides[0].reached.size() &&
+         sides[1].begin < sides[1].reached.size()) {
+    int s = sides[0].edges <= sides[1].edges ? 0 : 1;
+    weight_type best = expand(sides[s], sides[1 - s]);
+    if (best != UNREACHED) {
+      return best;
+    }
+  }
+  return UNREACHED;
+}
+
+template class Bidirectional<uint32_t>;
+template class Bidirectional<uint64_t>;
@@ -1,62 +1,116 @@
 #include "graph.hpp"
+#include <atomic>
 
-#define IS_VISITED(i) (visited[i])
+// Frontiers and visited set are bitsets of 64-bit words
+#define WORD(i) ((i) / 64)
+#define BIT(i) (1ULL << ((i) % 64))
+// Other threads may set bits of the same word of visited with fetch_or in
+// top-down steps, so the word is read atomically
+#define IS_VISITED(i)                                                          \
+  (std::atomic_ref<uint64_t>(visited[WORD(i)])                                 \
+       .load(std::memory_order_relaxed) &                                      \
+   BIT(i))
+#define IN_FRONTIER(frontier, i) (frontier[WORD(i)] & BIT(i))
 
-inline void Bitmap::add_to_frontier(bool *frontier, vidType v) {
-  frontier[v] = true;
-  visited[v] = true;
+template <typename eidType>
+inline void Bitmap<eidType>::add_to_frontier(uint64_t *frontier, vidType v) {
+  std::atomic_ref<uint64_t>(frontier[WORD(v)])
+      .fetch_or(BIT(v), std::memory_order_relaxed);
+  std::atomic_ref<uint64_t>(visited[WORD(v)])
+      .fetch_or(BIT(v), std::memory_order_relaxed);
 }
 
-Bitmap::Bitmap(Graph *graph)
-    : BFS_Impl(graph), this_frontier(new bool[graph->N]),
-      next_frontier(new bool[graph->N]), visited(new bool[graph->N]) {
+template <typename eidType>
+Bitmap<eidType>::Bitmap(Graph<eidType> *graph)
+    : BFS_Impl<eidType>(graph), words((graph->N + 63) / 64),
+      this_frontier(large_new<uint64_t>(words)),
+      next_frontier(large_new<uint64_t>(words)),
+      visited(large_new<uint64_t>(words)) {
 #pragma omp parallel for schedule(static)
-  for (eidType i = 0; i < graph->N; i++) {
-    this_frontier[i] = false;
-    next_frontier[i] = false;
-    visited[i] = false;
+  for (uint64_t w = 0; w < words; w++) {
+    this_frontier[w] = 0;
+    next_frontier[w] = 0;
+    visited[w] = 0;
   }
 }
 
-Bitmap::~Bitmap() {
-  delete[] this_frontier;
-  delete[] next_frontier;
-  delete[] visited;
+template <typename eidType>
+Bitmap<eidType>::~Bitmap() {
+  large_delete(this_frontier);
+  large_delete(next_frontier);
+  large_delete(visited);
 }
 
-void Bitmap::bottom_up_step(const bool *this_frontier, bool *next_frontier) {
+// Each thread owns whole words of the next frontier, so no atomics are needed
+template <typename eidType>
+void Bitmap<eidType>::bottom_up_step(const uint64_t *this_frontier,
+                                     uint64_t *next_frontier) {
+  PERF_REGION("Bitmap::bottom_up_step");
 #pragma omp parallel for schedule(static)
-  for (vidType i = 0; i < graph->N; i++) {
-    if (!IS_VISITED(i)) {
+  for (uint64_t w = 0; w < words; w++) {
+    uint64_t unvisited = ~visited[w];
+    if (w == words - 1 && graph->N % 64 != 0) {
+      unvisited &= BIT(graph->N) - 1;
+    }
+    uint64_t found = 0;
+    while (unvisited != 0) {
+      vidType i = w * 64 + __builtin_ctzll(unvisited);
+      unvisited &= unvisited - 1;
       for (eidType j = graph->rowptr[i]; j < graph->rowptr[i + 1]; j++) {
         vidType neighbor = graph->col[j];
-        if (this_frontier[neighbor] == true) {
+        if (IN_FRONTIER(this_frontier, neighbor)) {
           // If neighbor is in frontier, add this vertex to next frontier
-          add_to_frontier(next_frontier, i);
+          found |= BIT(i);
           break;
         }
       }
     }
+    next_frontier[w] = found;
+    visited[w] |= found;
   }
 }
 
-void Bitmap::top_down_step(const bool *this_frontier, bool *next_frontier) {
-#pragma omp parallel for schedule(static)
-  for (int v = 0; v < graph->N; v++) {
-    if (this_frontier[v] == true) {
-      eidType end = graph->rowptr[v + 1];
-#pragma omp simd
-      for (eidType i = graph->rowptr[v]; i < end; i++) {
+template <typename eidType>
+void Bitmap<eidType>::top_down_step(const uint64_t *this_frontier,
+                                    uint64_t *next_frontier) {
+  PERF_REGION("Bitmap::top_down_step");
+  heavy.clear();
+#pragma omp parallel
+  {
+    auto visit = [&](eidType begin, eidType end) {
+      for (eidType i = begin; i < end; i++) {
         vidType neighbor = graph->col[i];
         if (!IS_VISITED(neighbor)) {
           add_to_frontier(next_frontier, neighbor);
         }
       }
+    };
+    std::vector<EdgeChunk<eidType>> &local_heavy = heavy.local();
+#pragma omp for schedule(static)
+    for (uint64_t w = 0; w < words; w++) {
+      uint64_t bits = this_frontier[w];
+      while (bits != 0) {
+        vidType v = w * 64 + __builtin_ctzll(bits);
+        bits &= bits - 1;
+        if (graph->rowptr[v + 1] - graph->rowptr[v] > HEAVY_DEGREE) {
+          split_edges(local_heavy, graph->rowptr[v], graph->rowptr[v + 1]);
+        } else {
+          visit(graph->rowptr[v], graph->rowptr[v + 1]);
+        }
+      }
+    }
+    heavy.flush();
+#pragma omp for schedule(dynamic, 1)
+    for (const auto &chunk : heavy) {
+      visit(chunk.begin, chunk.end);
     }
   }
 }
 
-void Bitmap::BFS(vidType source, weight_type *distances) {
+template <typename eidType>
+void Bitmap<eidType>::BFS(vidType source, weight_type *distances) {
+  PERF_REGION("Bitmap::BFS");
+  TRACE_RUN("Bitmap", source);
   eidType unexplored_edges = graph->M;
   eidType unvisited_vertices = graph->N;
   Direction dir = Direction::TOP_DOWN;
@@ -67,12 +121,13 @@ void Bitmap::BFS(vidType source, weight_type *distances) {
   weight_type distance = 1;
 
   do {
-    if (dir == Direction::BOTTOM_UP && vertices_frontier < graph->N / BETA) {
+    if (dir == Direction::BOTTOM_UP && vertices_frontier < graph->N / beta) {
       dir = Direction::TOP_DOWN;
     } else if (dir == Direction::TOP_DOWN &&
-               edges_frontier > unexplored_edges / ALPHA) {
+               edges_frontier > unexplored_edges / alpha) {
       dir = Direction::BOTTOM_UP;
     }
+    TRACE_LEVEL_BEGIN(dir, vertices_frontier, edges_frontier, unexplored_edges);
     unexplored_edges -= edges_frontier;
     unvisited_vertices -= vertices_frontier;
     edges_frontier = 0;
@@ -82,13 +137,21 @@ void Bitmap::BFS(vidType source, weight_type *distances) {
     } else {
       bottom_up_step(this_frontier, next_frontier);
     }
+    TRACE_LEVEL_END();
+    // Count and clear the frontiers a word at a time, skipping empty words
 #pragma omp parallel for reduction(+ : edges_frontier, vertices_frontier)      \
     schedule(static)
-    for (vidType i = 0; i < graph->N; i++) {
-      this_frontier[i] = false;
-      if (next_frontier[i] == true) {
+    for (uint64_t w = 0; w < words; w++) {
+      this_frontier[w] = 0;
+      uint64_t bits = next_frontier[w];
+      if (bits == 0) {
+        continue;
+      }
+      vertices_frontier += __builtin_popcountll(bits);
+      while (bits != 0) {
+        vidType i = w * 64 + __builtin_ctzll(bits);
+        bits &= bits - 1;
         edges_frontier += graph->rowptr[i + 1] - graph->rowptr[i];
-        vertices_frontier += 1;
         distances[i] = distance;
       }
     }
@@ -99,12 +162,16 @@ void Bitmap::BFS(vidType source, weight_type *distances) {
     distance++;
   } while (true);
 #pragma omp parallel for schedule(static)
-  for (vidType i = 0; i < graph->N; i++) {
-    this_frontier[i] = false;
-    visited[i] = false;
+  for (uint64_t w = 0; w < words; w++) {
+    this_frontier[w] = 0;
+    visited[w] = 0;
   }
 }
 
-bool Bitmap::check_result(vidType source, weight_type *distances) {
-  return BFS_Impl::check_distances(source, distances);
-}
\ No newline at end of file
+template <typename eidType>
+bool Bitmap<eidType>::check_result(vidType source, weight_type *distances) {
+  return BFS_Impl<eidType>::check_distances(source, distances);
+}
+
+template class Bitmap<uint32_t>;
+template class Bitmap<uint64_t>;
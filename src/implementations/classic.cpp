@@ -1,86 +1,126 @@
 #include "graph.hpp"
 
-Classic::Classic(Graph *graph) : BFS_Impl(graph), visited(new bool[graph->N]) {}
+template <typename eidType>
+Classic<eidType>::Classic(Graph<eidType> *graph)
+    : BFS_Impl<eidType>(graph), visited(large_new<bool>(graph->N)) {
+#pragma omp parallel for schedule(static)
+  for (vidType i = 0; i < graph->N; i++) {
+    visited[i] = false;
+  }
+}
 
-Classic::~Classic() { delete[] visited; }
+template <typename eidType>
+Classic<eidType>::~Classic() { large_delete(visited); }
 
-inline void Classic::set_distance(vidType i, weight_type distance,
-                                  weight_type *distances) {
+template <typename eidType>
+inline void Classic<eidType>::set_distance(vidType i, weight_type distance,
+                                           weight_type *distances) {
   distances[i] = distance;
   visited[i] = true;
 }
 
-inline void Classic::add_to_frontier(frontier &frontier, vidType v,
-                                     vidType &edges_frontier) {
+template <typename eidType>
+inline void Classic<eidType>::add_to_frontier(std::vector<vidType> &frontier,
+                                              vidType v,
+                                              eidType &edges_frontier) {
   frontier.push_back(v);
   edges_frontier += graph->rowptr[v + 1] - graph->rowptr[v];
 }
 
-#pragma omp declare reduction(                                                 \
-        vec_add : std::vector<vidType>,                                        \
-            std::vector<std::pair<vidType, bool>> : omp_out.insert(            \
-                    omp_out.end(), omp_in.begin(), omp_in.end()))
-
-void Classic::bottom_up_step(frontier this_frontier, frontier &next_frontier,
-                             weight_type distance, weight_type *distances,
-                             vidType &edges_frontier) {
-#pragma omp parallel for reduction(vec_add : next_frontier)                    \
-    reduction(+ : edges_frontier) schedule(static)
-  for (vidType i = 0; i < graph->N; i++) {
-    if (!visited[i]) {
-      for (vidType j = graph->rowptr[i]; j < graph->rowptr[i + 1]; j++) {
-        if (visited[graph->col[j]] &&
-            distances[graph->col[j]] == distance - 1) {
-          // If neighbor is in frontier, add this vertex to next frontier
-          if (graph->rowptr[i + 1] - graph->rowptr[i] > 1) {
-            add_to_frontier(next_frontier, i, edges_frontier);
+template <typename eidType>
+void Classic<eidType>::bottom_up_step(const Frontier<vidType> &this_frontier,
+                                      Frontier<vidType> &next_frontier,
+                                      weight_type distance,
+                                      weight_type *distances,
+                                      eidType &edges_frontier) {
+  PERF_REGION("Classic::bottom_up_step");
+#pragma omp parallel
+  {
+    std::vector<vidType> &local_frontier = next_frontier.local();
+#pragma omp for reduction(+ : edges_frontier) schedule(static)
+    for (vidType i = 0; i < graph->N; i++) {
+      if (!visited[i]) {
+        for (eidType j = graph->rowptr[i]; j < graph->rowptr[i + 1]; j++) {
+          if (visited[graph->col[j]] &&
+              distances[graph->col[j]] == distance - 1) {
+            // If neighbor is in frontier, add this vertex to next frontier
+            if (graph->rowptr[i + 1] - graph->rowptr[i] > 1) {
+              add_to_frontier(local_frontier, i, edges_frontier);
+            }
+            set_distance(i, distance, distances);
+            break;
           }
-          set_distance(i, distance, distances);
-          break;
         }
       }
     }
+    next_frontier.flush();
   }
 }
 
-void Classic::top_down_step(frontier this_frontier, frontier &next_frontier,
-                            weight_type &distance, weight_type *distances,
-                            vidType &edges_frontier,
-                            vidType edges_frontier_old) {
-#pragma omp parallel for reduction(vec_add : next_frontier)                    \
-    reduction(+ : edges_frontier)                                              \
-    schedule(static) if (edges_frontier_old > 150)
-  for (const auto &v : this_frontier) {
-    for (vidType i = graph->rowptr[v]; i < graph->rowptr[v + 1]; i++) {
-      vidType neighbor = graph->col[i];
-      if (!visited[neighbor]) {
-        if (graph->rowptr[neighbor + 1] - graph->rowptr[neighbor] > 1) {
-          add_to_frontier(next_frontier, neighbor, edges_frontier);
+template <typename eidType>
+void Classic<eidType>::top_down_step(const Frontier<vidType> &this_frontier,
+                                     Frontier<vidType> &next_frontier,
+                                     weight_type &distance,
+                                     weight_type *distances,
+                                     eidType &edges_frontier,
+                                     eidType edges_frontier_old) {
+  PERF_REGION("Classic::top_down_step");
+  heavy.clear();
+#pragma omp parallel if (edges_frontier_old > 150)
+  {
+    std::vector<vidType> &local_frontier = next_frontier.local();
+    // Takes the reduction variable, which is private to each loop
+    auto visit = [&](eidType begin, eidType end, eidType &edges) {
+      for (eidType i = begin; i < end; i++) {
+        vidType neighbor = graph->col[i];
+        if (!visited[neighbor]) {
+          if (graph->rowptr[neighbor + 1] - graph->rowptr[neighbor] > 1) {
+            add_to_frontier(local_frontier, neighbor, edges);
+          }
+          set_distance(neighbor, distance, distances);
         }
-        set_distance(neighbor, distance, distances);
       }
+    };
+    std::vector<EdgeChunk<eidType>> &local_heavy = heavy.local();
+#pragma omp for reduction(+ : edges_frontier) schedule(static)
+    for (const auto &v : this_frontier) {
+      if (graph->rowptr[v + 1] - graph->rowptr[v] > HEAVY_DEGREE) {
+        split_edges(local_heavy, graph->rowptr[v], graph->rowptr[v + 1]);
+      } else {
+        visit(graph->rowptr[v], graph->rowptr[v + 1], edges_frontier);
+      }
+    }
+    heavy.flush();
+#pragma omp for reduction(+ : edges_frontier) schedule(dynamic, 1)
+    for (const auto &chunk : heavy) {
+      visit(chunk.begin, chunk.end, edges_frontier);
     }
+    next_frontier.flush();
   }
 }
 
-void Classic::BFS(vidType source, weight_type *distances) {
+template <typename eidType>
+void Classic<eidType>::BFS(vidType source, weight_type *distances) {
+  PERF_REGION("Classic::BFS");
+  TRACE_RUN("Classic", source);
   eidType unexplored_edges = graph->M;
-  vidType edges_frontier_old = 0;
-  frontier this_frontier;
+  eidType edges_frontier_old = 0;
   Direction dir = Direction::TOP_DOWN;
-  vidType edges_frontier = 0;
-  add_to_frontier(this_frontier, source, edges_frontier);
+  eidType edges_frontier = graph->rowptr[source + 1] - graph->rowptr[source];
+  this_frontier.clear();
+  this_frontier.push_back(source);
   set_distance(source, 0, distances);
   weight_type distance = 1;
   while (!this_frontier.empty()) {
-    frontier next_frontier;
-    next_frontier.reserve(this_frontier.size());
-    if (dir == Direction::BOTTOM_UP && this_frontier.size() < graph->N / BETA) {
+    next_frontier.clear();
+    if (dir == Direction::BOTTOM_UP && this_frontier.size() < graph->N / beta) {
       dir = Direction::TOP_DOWN;
     } else if (dir == Direction::TOP_DOWN &&
-               edges_frontier > unexplored_edges / ALPHA) {
+               edges_frontier > unexplored_edges / alpha) {
       dir = Direction::BOTTOM_UP;
     }
+    TRACE_LEVEL_BEGIN(dir, this_frontier.size(), edges_frontier,
+                      unexplored_edges);
     unexplored_edges -= edges_frontier;
     edges_frontier_old = edges_frontier;
     edges_frontier = 0;
@@ -91,11 +131,20 @@ void Classic::BFS(vidType source, weight_type *distances) {
       bottom_up_step(this_frontier, next_frontier, distance, distances,
                      edges_frontier);
     }
+    TRACE_LEVEL_END();
     distance++;
-    this_frontier = std::move(next_frontier);
+    std::swap(this_frontier, next_frontier);
+  }
+#pragma omp parallel for schedule(static)
+  for (vidType i = 0; i < graph->N; i++) {
+    visited[i] = false;
   }
 }
 
-bool Classic::check_result(vidType source, weight_type *distances) {
-  return BFS_Impl::check_distances(source, distances);
-}
\ No newline at end of file
+template <typename eidType>
+bool Classic<eidType>::check_result(vidType source, weight_type *distances) {
+  return BFS_Impl<eidType>::check_distances(source, distances);
+}
+
+template class Classic<uint32_t>;
+template class Classic<uint64_t>;
@@ -0,0 +1,211 @@
+#include "graph.hpp"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <omp.h>
+#include <stdexcept>
+
+#define DEGREE(vertex) merged_csr[vertex]
+#define DISTANCE(vertex) merged_csr[vertex + 1]
+#define UNREACHED std::numeric_limits<weight_type>::max()
+#define NO_BUCKET std::numeric_limits<size_t>::max()
+
+template <typename eidType>
+DeltaStepping<eidType>::DeltaStepping(Graph<eidType> *graph, weight_type delta)
+    : BFS_Impl<eidType>(graph), buckets(omp_get_max_threads()), delta(delta) {
+  if (!graph->weighted()) {
+    throw std::runtime_error("Error: delta_stepping needs a weighted dataset");
+  }
+  create_merged_csr();
+}
+
+template <typename eidType>
+DeltaStepping<eidType>::~DeltaStepping() {
+  large_delete(merged_csr);
+  large_delete(merged_rowptr);
+}
+
+// Create the weighted merged CSR from CSR. As in MergedCSR, the record of each
+// vertex starts at a known position (2 * rowptr[i] + 2 * i), so every thread
+// fills its own range of vertices independently
+template <typename eidType>
+void DeltaStepping<eidType>::create_merged_csr() {
+  merged_csr = large_new<eidType>(2 * (eidType)graph->M + 2 * graph->N);
+  merged_rowptr = large_new<eidType>(graph->N + 1);
+
+  uint64_t total_weight = 0;
+  weight_type heaviest = 0;
+#pragma omp parallel for schedule(static) reduction(+ : total_weight)         \
+    reduction(max : heaviest)
+  for (vidType i = 0; i < graph->N; i++) {
+    eidType start = graph->rowptr[i];
+    eidType merged_index = 2 * start + 2 * (eidType)i;
+    merged_rowptr[i] = merged_index;
+    merged_csr[merged_index++] = graph->rowptr[i + 1] - start;
+    merged_csr[merged_index++] = UNREACHED;
+    for (eidType j = start; j < graph->rowptr[i + 1]; j++) {
+      merged_csr[merged_index++] =
+          2 * graph->rowptr[graph->col[j]] + 2 * (eidType)graph->col[j];
+      merged_csr[merged_index++] = graph->weights[j];
+      total_weight += graph->weights[j];
+      heaviest = std::max<weight_type>(heaviest, graph->weights[j]);
+    }
+  }
+  max_weight = heaviest;
+  merged_rowptr[graph->N] = 2 * (eidType)graph->M + 2 * graph->N;
+
+  if (delta == 0) {
+    delta = std::max<uint64_t>(1, total_weight / std::max<uint64_t>(1, graph->M));
+  }
+}
+
+// Extract distances from the weighted merged CSR
+template <typename eidType>
+void DeltaStepping<eidType>::compute_distances(weight_type *distances) const {
+#pragma omp parallel for simd schedule(static)
+  for (vidType i = 0; i < graph->N; i++) {
+    distances[i] = DISTANCE(merged_rowptr[i]);
+    // Reset distance for next run
+    DISTANCE(merged_rowptr[i]) = UNREACHED;
+  }
+}
+
+template <typename eidType>
+void DeltaStepping<eidType>::Buckets::resize(size_t num_bins) {
+  if (bins.size() != num_bins) {
+    bins.assign(num_bins, {});
+    occupied.assign((num_bins + 63) / 64, 0);
+  }
+}
+
+template <typename eidType>
+void DeltaStepping<eidType>::Buckets::push(size_t b, eidType vertex) {
+  size_t bin = b % bins.size();
+  occupied[bin / 64] |= 1ULL << (bin % 64);
+  bins[bin].push_back(vertex);
+}
+
+template <typename eidType>
+void DeltaStepping<eidType>::Buckets::take(size_t b,
+                                           std::vector<eidType> &out) {
+  size_t bin = b % bins.size();
+  occupied[bin / 64] &= ~(1ULL << (bin % 64));
+  std::swap(out, bins[bin]);
+}
+
+// First non-empty bin in [from, to), or NO_BUCKET
+template <typename eidType>
+size_t DeltaStepping<eidType>::Buckets::first_occupied(size_t from,
+                                                       size_t to) const {
+  for (size_t w = from / 64; w * 64 < to; w++) {
+    uint64_t bits = occupied[w];
+    if (w == from / 64) {
+      bits &= ~0ULL << (from % 64);
+    }
+    if (bits != 0) {
+      size_t bin = w * 64 + __builtin_ctzll(bits);
+      return bin < to ? bin : NO_BUCKET;
+    }
+  }
+  return NO_BUCKET;
+}
+
+// The bins hold the buckets [b, b + bins.size()), so the search wraps around
+// at most once, a word of the bitmap at a time
+template <typename eidType>
+size_t DeltaStepping<eidType>::Buckets::next(size_t b) const {
+  size_t start = b % bins.size();
+  size_t bin = first_occupied(start, bins.size());
+  if (bin != NO_BUCKET) {
+    return b + (bin - start);
+  }
+  bin = first_occupied(0, start);
+  if (bin != NO_BUCKET) {
+    return b + (bins.size() - start) + bin;
+  }
+  return NO_BUCKET;
+}
+
+// Relax the edges of the vertices in this_frontier, which holds the bucket
+// being settled. Improved vertices go to the bucket of their new distance,
+// which may be the current one again. The smallest non-empty bucket is then
+// moved to next_frontier and returned, or NO_BUCKET if all are empty
+template <typename eidType>
+size_t DeltaStepping<eidType>::relax_step(size_t bucket) {
+  PERF_REGION("DeltaStepping::relax_step");
+  size_t next_bucket = NO_BUCKET;
+#pragma omp parallel
+  {
+    Buckets &own = buckets[omp_get_thread_num()];
+#pragma omp for schedule(dynamic, 64)
+    for (const auto &v : this_frontier) {
+      eidType v_distance = DISTANCE(v);
+      // Skip the copies left in this bucket by vertices improved since
+      if (v_distance / delta != bucket) {
+        continue;
+      }
+      eidType end = v + 2 + 2 * DEGREE(v);
+      for (eidType i = v + 2; i < end; i += 2) {
+        eidType neighbor = merged_csr[i];
+        eidType candidate = v_distance + merged_csr[i + 1];
+        std::atomic_ref<eidType> n_distance(DISTANCE(neighbor));
+        eidType current = n_distance.load(std::memory_order_relaxed);
+        // On failure current is reloaded, so a concurrent smaller distance
+        // ends the loop
+        while (candidate < current) {
+          if (n_distance.compare_exchange_weak(current, candidate,
+                                               std::memory_order_relaxed)) {
+            own.push(candidate / delta, neighbor);
+            break;
+          }
+        }
+      }
+    }
+
+    size_t local_next = own.next(bucket);
+#pragma omp critical
+    next_bucket = std::min(next_bucket, local_next);
+#pragma omp barrier
+    if (next_bucket != NO_BUCKET) {
+      // The local buffer is empty after the previous flush
+      own.take(next_bucket, next_frontier.local());
+    }
+    next_frontier.flush();
+  }
+  return next_bucket;
+}
+
+// Buckets are settled in increasing order. A vertex may be relaxed more than
+// once within a bucket, as long as its distance keeps improving
+template <typename eidType>
+void DeltaStepping<eidType>::BFS(vidType source, weight_type *distances) {
+  PERF_REGION("DeltaStepping::BFS");
+  TRACE_RUN("DeltaStepping", source);
+  // delta may have changed since the last run
+  size_t num_bins = (max_weight + (size_t)delta - 1) / delta + 1;
+  for (auto &own : buckets) {
+    own.resize(num_bins);
+  }
+  this_frontier.clear();
+  this_frontier.push_back(merged_rowptr[source]);
+  DISTANCE(merged_rowptr[source]) = 0;
+  size_t bucket = 0;
+  while (bucket != NO_BUCKET) {
+    TRACE_LEVEL_BEGIN(TOP_DOWN, this_frontier.size(), TRACE_UNKNOWN,
+                      TRACE_UNKNOWN);
+    next_frontier.clear();
+    bucket = relax_step(bucket);
+    TRACE_LEVEL_END();
+    std::swap(this_frontier, next_frontier);
+  }
+  compute_distances(distances);
+}
+
+template <typename eidType>
+bool DeltaStepping<eidType>::check_result(vidType source,
+                                          weight_type *distances) {
+  return BFS_Impl<eidType>::check_weighted_distances(source, distances);
+}
+
+template class DeltaStepping<uint32_t>;
+template class DeltaStepping<uint64_t>;
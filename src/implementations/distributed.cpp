@@ -0,0 +1,352 @@
+#ifdef BFS_MPI
+#include "distributed.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fcntl.h>
+#include <limits>
+#include <stdexcept>
+#include <unistd.h>
+
+#define UNREACHED std::numeric_limits<weight_type>::max()
+#define WORD(i) ((i) / 64)
+#define BIT(i) (1ULL << ((i) % 64))
+
+// Offsets in a binary dataset: a 16-byte header (N and M), then N + 1 uint64_t
+// of rowptr, then M uint32_t of col
+#define ROWPTR_OFFSET(v) (2 * sizeof(uint64_t) + sizeof(uint64_t) * (v))
+#define COL_OFFSET(N, i) (ROWPTR_OFFSET((N) + 1) + sizeof(uint32_t) * (i))
+
+// Read bytes at offset of the dataset, pread may return less than asked
+static void read_at(int fd, void *buffer, uint64_t bytes, uint64_t offset,
+                    const std::string &path) {
+  char *out = static_cast<char *>(buffer);
+  while (bytes > 0) {
+    ssize_t n = pread(fd, out, std::min<uint64_t>(bytes, 1ULL << 30), offset);
+    if (n <= 0) {
+      close(fd);
+      throw std::runtime_error("Error: Truncated file " + path);
+    }
+    out += n;
+    offset += n;
+    bytes -= n;
+  }
+}
+
+// The local rows are copied from the graph if it is loaded, or else (after
+// LoadMode::HEADER) read from the binary dataset, so that a rank never holds
+// more of the graph than its own rows
+template <typename eidType>
+Distributed<eidType>::Distributed(Graph<eidType> *graph, MPI_Comm comm)
+    : BFS_Impl<eidType>(graph), comm(comm), words((graph->N + 63) / 64) {
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &num_ranks);
+
+  int fd = -1;
+  const std::string &path = graph->dataset_path;
+  if (graph->rowptr == nullptr) {
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+      throw std::runtime_error("Error: Unable to open file " + path);
+    }
+  }
+  auto row = [&](uint64_t v) -> uint64_t {
+    if (fd == -1) {
+      return graph->rowptr[v];
+    }
+    uint64_t value;
+    read_at(fd, &value, sizeof(value), ROWPTR_OFFSET(v), path);
+    return value;
+  };
+
+  // Rank r starts at the first vertex v with rowptr[v] + v >= r * (M + N) / P,
+  // so that every rank has about the same share of vertices plus edges
+  bounds.resize(num_ranks + 1);
+  for (int r = 0; r <= num_ranks; r++) {
+    uint64_t target = (graph->M + graph->N) * r / num_ranks;
+    uint64_t low = 0, high = graph->N;
+    while (low < high) {
+      uint64_t mid = (low + high) / 2;
+      if (row(mid) + mid < target) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    bounds[r] = low;
+  }
+  for (int r = 0; r < num_ranks; r++) {
+    range_displs.push_back(bounds[r]);
+    range_counts.push_back(bounds[r + 1] - bounds[r]);
+  }
+  first = bounds[rank];
+  count = bounds[rank + 1] - first;
+
+  // Copy the local rows. With a mapped dataset only these rows of col are read
+  rowptr = large_new<eidType>(count + 1);
+  depth = large_new<weight_type>(count);
+  if (fd == -1) {
+    eidType offset = graph->rowptr[first];
+    col = large_new<vidType>(graph->rowptr[first + count] - offset);
+#pragma omp parallel for schedule(static)
+    for (vidType v = 0; v <= count; v++) {
+      rowptr[v] = graph->rowptr[first + v] - offset;
+    }
+#pragma omp parallel for schedule(static)
+    for (vidType v = 0; v < count; v++) {
+      std::copy(graph->col + offset + rowptr[v],
+                graph->col + offset + rowptr[v + 1], col + rowptr[v]);
+    }
+  } else {
+    std::vector<uint64_t> rows(count + 1);
+    read_at(fd, rows.data(), sizeof(uint64_t) * (count + 1),
+            ROWPTR_OFFSET(first), path);
+    if (rows[count] < rows[0] || rows[count] > graph->M) {
+      close(fd);
+      throw std::runtime_error("Error: Invalid rowptr in " + path);
+    }
+    col = large_new<vidType>(rows[count] - rows[0]);
+#pragma omp parallel for schedule(static)
+    for (vidType v = 0; v <= count; v++) {
+      rowptr[v] = rows[v] - rows[0];
+    }
+    read_at(fd, col, sizeof(vidType) * rowptr[count],
+            COL_OFFSET(graph->N, rows[0]), path);
+    close(fd);
+  }
+  frontier_bits = large_new<uint64_t>(words);
+
+  outbox.resize(num_ranks);
+  send_counts.resize(num_ranks);
+  send_displs.resize(num_ranks);
+  recv_counts.resize(num_ranks);
+  recv_displs.resize(num_ranks);
+}
+
+template <typename eidType>
+Distributed<eidType>::~Distributed() {
+  large_delete(rowptr);
+  large_delete(col);
+  large_delete(depth);
+  large_delete(frontier_bits);
+}
+
+template <typename eidType>
+int Distributed<eidType>::owner(vidType v) const {
+  return std::upper_bound(bounds.begin(), bounds.end(), v) - bounds.begin() -
+         1;
+}
+
+// Set the depth of a local vertex if it is unreached, so that only one thread
+// adds it to the frontier
+template <typename eidType>
+inline bool Distributed<eidType>::claim(vidType local, weight_type distance) {
+  std::atomic_ref<weight_type> local_depth(depth[local]);
+  weight_type unreached = UNREACHED;
+  return local_depth.load(std::memory_order_relaxed) == unreached &&
+         local_depth.compare_exchange_strong(unreached, distance,
+                                             std::memory_order_relaxed);
+}
+
+// Send the contents of outbox to their owners, receiving into recv_buffer
+template <typename eidType>
+void Distributed<eidType>::exchange() {
+  int send_total = 0;
+  for (int r = 0; r < num_ranks; r++) {
+    send_counts[r] = outbox[r].size();
+    send_displs[r] = send_total;
+    send_total += send_counts[r];
+  }
+  send_buffer.resize(send_total);
+  for (int r = 0; r < num_ranks; r++) {
+    std::copy(outbox[r].begin(), outbox[r].end(),
+              send_buffer.begin() + send_displs[r]);
+  }
+  MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT,
+               comm);
+  int recv_total = 0;
+  for (int r = 0; r < num_ranks; r++) {
+    recv_displs[r] = recv_total;
+    recv_total += recv_counts[r];
+  }
+  recv_buffer.resize(recv_total);
+  MPI_Alltoallv(send_buffer.data(), send_counts.data(), send_displs.data(),
+                MPI_UINT32_T, recv_buffer.data(), recv_counts.data(),
+                recv_displs.data(), MPI_UINT32_T, comm);
+}
+
+// Local neighbors are claimed directly, remote ones are sent to their owners,
+// which claim them after the exchange. A vertex may be sent several times
+template <typename eidType>
+void Distributed<eidType>::top_down_step(weight_type distance,
+                                         uint64_t &edges_frontier) {
+  PERF_REGION("Distributed::top_down_step");
+  for (auto &box : outbox) {
+    box.clear();
+  }
+#pragma omp parallel
+  {
+    std::vector<vidType> &local_next = next_frontier.local();
+#pragma omp for reduction(+ : edges_frontier) schedule(dynamic, 64)
+    for (const auto &u : this_frontier) {
+      for (eidType i = rowptr[u]; i < rowptr[u + 1]; i++) {
+        vidType v = col[i];
+        // Unsigned, so vertices before first wrap around too
+        if (v - first < count) {
+          if (claim(v - first, distance)) {
+            local_next.push_back(v - first);
+            edges_frontier += degree(v - first);
+          }
+        } else {
+          outbox[owner(v)].local().push_back(v);
+        }
+      }
+    }
+    for (auto &box : outbox) {
+      box.flush();
+    }
+    next_frontier.flush();
+  }
+
+  exchange();
+#pragma omp parallel
+  {
+    std::vector<vidType> &local_next = next_frontier.local();
+#pragma omp for reduction(+ : edges_frontier) schedule(static)
+    for (size_t i = 0; i < recv_buffer.size(); i++) {
+      vidType local = recv_buffer[i] - first;
+      if (claim(local, distance)) {
+        local_next.push_back(local);
+        edges_frontier += degree(local);
+      }
+    }
+    next_frontier.flush();
+  }
+}
+
+// The frontier bitmap of all ranks is the bitwise or of the local ones, then
+// every rank only updates its own vertices
+template <typename eidType>
+void Distributed<eidType>::bottom_up_step(weight_type distance,
+                                          uint64_t &edges_frontier) {
+  PERF_REGION("Distributed::bottom_up_step");
+#pragma omp parallel
+  {
+#pragma omp for schedule(static)
+    for (uint64_t w = 0; w < words; w++) {
+      frontier_bits[w] = 0;
+    }
+#pragma omp for schedule(static)
+    for (const auto &u : this_frontier) {
+      std::atomic_ref<uint64_t>(frontier_bits[WORD(first + u)])
+          .fetch_or(BIT(first + u), std::memory_order_relaxed);
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, frontier_bits, words, MPI_UINT64_T, MPI_BOR,
+                comm);
+
+#pragma omp parallel
+  {
+    std::vector<vidType> &local_next = next_frontier.local();
+#pragma omp for reduction(+ : edges_frontier) schedule(static)
+    for (vidType v = 0; v < count; v++) {
+      if (depth[v] == UNREACHED) {
+        for (eidType i = rowptr[v]; i < rowptr[v + 1]; i++) {
+          if (frontier_bits[WORD(col[i])] & BIT(col[i])) {
+            depth[v] = distance;
+            local_next.push_back(v);
+            edges_frontier += degree(v);
+            break;
+          }
+        }
+      }
+    }
+    next_frontier.flush();
+  }
+}
+
+template <typename eidType>
+void Distributed<eidType>::BFS(vidType source, weight_type *distances) {
+  PERF_REGION("Distributed::BFS");
+  TRACE_RUN("Distributed", source);
+#pragma omp parallel for schedule(static)
+  for (vidType v = 0; v < count; v++) {
+    depth[v] = UNREACHED;
+  }
+  this_frontier.clear();
+  uint64_t edges_frontier = 0;
+  if (source - first < count) {
+    depth[source - first] = 0;
+    this_frontier.push_back(source - first);
+    edges_frontier = degree(source - first);
+  }
+
+  uint64_t unexplored_edges = graph->M;
+  weight_type distance = 1;
+  Direction dir = Direction::TOP_DOWN;
+  while (true) {
+    // Frontier vertices and edges of all ranks
+    uint64_t totals[2] = {this_frontier.size(), edges_frontier};
+    MPI_Allreduce(MPI_IN_PLACE, totals, 2, MPI_UINT64_T, MPI_SUM, comm);
+    if (totals[0] == 0) {
+      break;
+    }
+    // Switch direction as in Bitmap::BFS, on the global frontier
+    if (dir == Direction::BOTTOM_UP && totals[0] < graph->N / beta) {
+      dir = Direction::TOP_DOWN;
+    } else if (dir == Direction::TOP_DOWN &&
+               totals[1] > unexplored_edges / alpha) {
+      dir = Direction::BOTTOM_UP;
+    }
+    TRACE_LEVEL_BEGIN(dir, totals[0], totals[1], unexplored_edges);
+    unexplored_edges -= std::min(totals[1], unexplored_edges);
+    edges_frontier = 0;
+    next_frontier.clear();
+    if (dir == Direction::TOP_DOWN) {
+      top_down_step(distance, edges_frontier);
+    } else {
+      bottom_up_step(distance, edges_frontier);
+    }
+    TRACE_LEVEL_END();
+    distance++;
+    std::swap(this_frontier, next_frontier);
+  }
+
+  MPI_Allgatherv(depth, count, MPI_UINT32_T, distances, range_counts.data(),
+                 range_displs.data(), MPI_UINT32_T, comm);
+}
+
+// Every rank checks the BFS invariants (see BFS_Impl::check_levels) of its own
+// vertices, on its rows and the gathered distances
+template <typename eidType>
+bool Distributed<eidType>::check_result(vidType source,
+                                        weight_type *distances) {
+  if (source >= graph->N) {
+    printf("Invalid source %u\n", source);
+    return false;
+  }
+  uint64_t errors = 0;
+  vidType first_error = graph->N;
+#pragma omp parallel for reduction(+ : errors) reduction(min : first_error)   \
+    schedule(dynamic, 1024)
+  for (vidType v = 0; v < count; v++) {
+    if (BFS_Impl<eidType>::level_error(source, distances, nullptr, first + v,
+                                       col + rowptr[v],
+                                       col + rowptr[v + 1]) != nullptr) {
+      errors++;
+      first_error = std::min<vidType>(first_error, first + v);
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &errors, 1, MPI_UINT64_T, MPI_SUM, comm);
+  MPI_Allreduce(MPI_IN_PLACE, &first_error, 1, MPI_UINT32_T, MPI_MIN, comm);
+  if (errors != 0) {
+    printf("Incorrect value for vertex %u at depth %u (%lu incorrect "
+           "vertices)\n",
+           first_error, distances[first_error], errors);
+  }
+  return errors == 0;
+}
+
+template class Distributed<uint32_t>;
+template class Distributed<uint64_t>;
+#endif
@@ -1,93 +1,195 @@
 #include "graph.hpp"
+#include <algorithm>
 #include <limits>
 
 #define DEGREE(vertex) merged_csr[vertex]
 #define DISTANCE(vertex) merged_csr[vertex + 1]
 
-MergedCSR::MergedCSR(Graph *graph) : BFS_Impl(graph) {
+// If use_cache is set, the merged layout is mapped from its on-disk cache when
+// a valid one exists, and written there after being built otherwise
+template <typename eidType>
+MergedCSR<eidType>::MergedCSR(Graph<eidType> *graph, bool use_cache)
+    : BFS_Impl<eidType>(graph) {
+  set_simd(detect_simd());
+  if (use_cache && cache.load(graph, MERGED_DISTANCES, merged_rowptr,
+                              merged_csr)) {
+    return;
+  }
   create_merged_csr();
+  if (use_cache) {
+    MergedCache<eidType>::store(graph, MERGED_DISTANCES, merged_rowptr,
+                                merged_csr);
+  }
+}
+
+template <typename eidType>
+void MergedCSR<eidType>::set_simd(SimdLevel level) {
+  simd = level;
+  kernel = top_down_kernel<eidType>(simd, graph->M + 2 * graph->N);
 }
 
-MergedCSR::~MergedCSR() { delete[] merged_csr; }
+template <typename eidType>
+MergedCSR<eidType>::~MergedCSR() {
+  if (!cache.is_mapped()) {
+    large_delete(merged_csr);
+    large_delete(merged_rowptr);
+  }
+}
 
-// Create merged CSR from CSR
-void MergedCSR::create_merged_csr() {
-  merged_csr = new eidType[graph->M + 2 * graph->N];
-  merged_rowptr = new eidType[graph->N];
-  eidType merged_index = 0;
+// Create merged CSR from CSR. The position of each neighbor list is known in
+// advance (rowptr[i] + 2 * i), so every thread fills its own range of vertices
+// independently. With schedule(static) the pages of each range are first
+// touched, and therefore placed, by the thread that owns it
+template <typename eidType>
+void MergedCSR<eidType>::create_merged_csr() {
+  merged_csr = large_new<eidType>(graph->M + 2 * graph->N);
+  merged_rowptr = large_new<eidType>(graph->N + 1);
 
+#pragma omp parallel for schedule(static)
   for (vidType i = 0; i < graph->N; i++) {
     eidType start = graph->rowptr[i];
+    eidType merged_index = start + 2 * (eidType)i;
+    // Fix rowptr indices caused by adding the degree to the start of each
+    // neighbor list
+    merged_rowptr[i] = merged_index;
     // Add degree to start of neighbor list
-    merged_csr[merged_index++] = graph->rowptr[i + 1] - graph->rowptr[i];
+    merged_csr[merged_index++] = graph->rowptr[i + 1] - start;
     // Initialize distance
     merged_csr[merged_index++] = std::numeric_limits<weight_type>::max();
     // Copy neighbors
     for (eidType j = start; j < graph->rowptr[i + 1]; j++) {
-      merged_csr[merged_index++] = graph->rowptr[graph->col[j]] + 2 * graph->col[j];
+      merged_csr[merged_index++] =
+          graph->rowptr[graph->col[j]] + 2 * (eidType)graph->col[j];
     }
   }
-  // Fix rowptr indices caused by adding the degree to the start of each
-  // neighbor list
-  for (vidType i = 0; i <= graph->N; i++) {
-    merged_rowptr[i] = graph->rowptr[i] + 2 * i;
-  }
+  merged_rowptr[graph->N] = graph->M + 2 * graph->N;
 }
 
 // Extract distances from merged CSR
-void MergedCSR::compute_distances(weight_type *distances,
-                                  vidType source) const {
+template <typename eidType>
+void MergedCSR<eidType>::compute_distances(weight_type *distances,
+                                           vidType source) const {
 #pragma omp parallel for simd schedule(static)
   for (vidType i = 0; i < graph->N; i++) {
     distances[i] = DISTANCE(merged_rowptr[i]);
     // Reset distance for next BFS
-    DISTANCE(merged_rowptr[i] + 1) = std::numeric_limits<weight_type>::max();
+    DISTANCE(merged_rowptr[i]) = std::numeric_limits<weight_type>::max();
   }
   distances[source] = 0;
 }
 
-#pragma omp declare reduction(vec_add                                          \
-:frontier : omp_out.insert(omp_out.end(), omp_in.begin(), omp_in.end()))
+template <typename eidType>
+void MergedCSR<eidType>::top_down_step(const Frontier<eidType> &this_frontier,
+                                       Frontier<eidType> &next_frontier,
+                                       const weight_type &distance,
+                                       eidType &edges_frontier,
+                                       eidType edges_frontier_old) {
+  PERF_REGION("MergedCSR::top_down_step");
+  heavy.clear();
+#pragma omp parallel if (this_frontier.size() > 50 ||                         \
+                             edges_frontier_old > HEAVY_DEGREE)
+  {
+    std::vector<eidType> &local_frontier = next_frontier.local();
+    // Takes the reduction variable, which is private to each loop. The
+    // kernel marks the unvisited neighbors and appends them to the frontier
+    auto visit = [&](eidType begin, eidType end, eidType &edges) {
+      edges += kernel(merged_csr, begin, end, distance, local_frontier);
+    };
+    std::vector<EdgeChunk<eidType>> &local_heavy = heavy.local();
+#pragma omp for reduction(+ : edges_frontier) schedule(static)
+    for (const auto &v : this_frontier) {
+      if (DEGREE(v) > HEAVY_DEGREE) {
+        split_edges(local_heavy, v + 2, v + 2 + DEGREE(v));
+      } else {
+        visit(v + 2, v + 2 + DEGREE(v), edges_frontier);
+      }
+    }
+    heavy.flush();
+#pragma omp for reduction(+ : edges_frontier) schedule(dynamic, 1)
+    for (const auto &chunk : heavy) {
+      visit(chunk.begin, chunk.end, edges_frontier);
+    }
+    next_frontier.flush();
+  }
+}
 
-void MergedCSR::top_down_step(const frontier &this_frontier,
-                              frontier &next_frontier,
-                              const weight_type &distance) {
-#pragma omp parallel for reduction(vec_add : next_frontier)                    \
-    schedule(static) if (this_frontier.size() > 50)
-  for (const auto &v : this_frontier) {
-    eidType end = v + 2 + DEGREE(v);
-// Iterate over neighbors
-#pragma omp simd
-    for (eidType i = v + 2; i < end; i++) {
-      eidType neighbor = merged_csr[i];
-      // If neighbor is not visited, add to frontier
-      if (DISTANCE(neighbor) == std::numeric_limits<weight_type>::max()) {
-        if (DEGREE(neighbor) != 1) {
-          next_frontier.push_back(neighbor);
+// Bottom-up step on the merged layout: every unvisited vertex looks for a
+// neighbor whose inline distance is the previous level
+template <typename eidType>
+void MergedCSR<eidType>::bottom_up_step(Frontier<eidType> &next_frontier,
+                                        const weight_type &distance,
+                                        eidType &edges_frontier) {
+  PERF_REGION("MergedCSR::bottom_up_step");
+#pragma omp parallel
+  {
+    std::vector<eidType> &local_frontier = next_frontier.local();
+#pragma omp for reduction(+ : edges_frontier) schedule(static)
+    for (vidType i = 0; i < graph->N; i++) {
+      eidType v = merged_rowptr[i];
+      if (DISTANCE(v) == std::numeric_limits<weight_type>::max()) {
+        eidType end = v + 2 + DEGREE(v);
+        for (eidType j = v + 2; j < end; j++) {
+          if (DISTANCE(merged_csr[j]) == distance - 1) {
+            // If neighbor is in frontier, add this vertex to next frontier
+            if (DEGREE(v) != 1) {
+              local_frontier.push_back(v);
+              edges_frontier += DEGREE(v);
+            }
+            DISTANCE(v) = distance;
+            break;
+          }
         }
-        DISTANCE(neighbor) = distance;
       }
     }
+    next_frontier.flush();
   }
 }
 
-void MergedCSR::BFS(vidType source, weight_type *distances) {
-  frontier this_frontier;
+template <typename eidType>
+void MergedCSR<eidType>::BFS(vidType source, weight_type *distances) {
+  PERF_REGION("MergedCSR::BFS");
+  TRACE_RUN("MergedCSR", source);
   eidType start = merged_rowptr[source];
 
+  this_frontier.clear();
   this_frontier.push_back(start);
   DISTANCE(start) = 0;
   weight_type distance = 1;
+  eidType unexplored_edges = graph->M;
+  eidType edges_frontier = DEGREE(start);
+  Direction dir = Direction::TOP_DOWN;
   while (!this_frontier.empty()) {
-    frontier next_frontier;
-    next_frontier.reserve(this_frontier.size());
-    top_down_step(this_frontier, next_frontier, distance);
+    // Switch direction as in Bitmap::BFS
+    if (dir == Direction::BOTTOM_UP && this_frontier.size() < graph->N / beta) {
+      dir = Direction::TOP_DOWN;
+    } else if (dir == Direction::TOP_DOWN &&
+               edges_frontier > unexplored_edges / alpha) {
+      dir = Direction::BOTTOM_UP;
+    }
+    TRACE_LEVEL_BEGIN(dir, this_frontier.size(), edges_frontier,
+                      unexplored_edges);
+    // Concurrent discoveries may add a vertex to the frontier twice
+    unexplored_edges -= std::min(edges_frontier, unexplored_edges);
+    eidType edges_frontier_old = edges_frontier;
+    edges_frontier = 0;
+    next_frontier.clear();
+    if (dir == Direction::TOP_DOWN) {
+      top_down_step(this_frontier, next_frontier, distance, edges_frontier,
+                    edges_frontier_old);
+    } else {
+      bottom_up_step(next_frontier, distance, edges_frontier);
+    }
+    TRACE_LEVEL_END();
     distance++;
-    this_frontier = std::move(next_frontier);
+    std::swap(this_frontier, next_frontier);
   }
   compute_distances(distances, source);
 }
 
-bool MergedCSR::check_result(vidType source, weight_type *distances) {
-  return BFS_Impl::check_distances(source, distances);
-}
\ No newline at end of file
+template <typename eidType>
+bool MergedCSR<eidType>::check_result(vidType source, weight_type *distances) {
+  return BFS_Impl<eidType>::check_distances(source, distances);
+}
+
+template class MergedCSR<uint32_t>;
+template class MergedCSR<uint64_t>;
@@ -0,0 +1,310 @@
+#include "graph.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#ifdef __SSSE3__
+#include <immintrin.h>
+#endif
+
+#define DEGREE(vertex) records[vertex]
+#define DISTANCE(vertex) records[(vertex) + 1]
+
+// Length in bytes of a group of four values and the shuffle that expands its
+// bytes to four 32-bit values, for every control byte
+struct GroupTables {
+  uint8_t length[256];
+  alignas(16) int8_t shuffle[256][16];
+
+  constexpr GroupTables() : length(), shuffle() {
+    for (int control = 0; control < 256; control++) {
+      int offset = 0;
+      for (int k = 0; k < 4; k++) {
+        int bytes = ((control >> (2 * k)) & 3) + 1;
+        for (int b = 0; b < 4; b++) {
+          shuffle[control][4 * k + b] = b < bytes ? offset + b : -1;
+        }
+        offset += bytes;
+      }
+      length[control] = offset;
+    }
+  }
+};
+
+static constexpr GroupTables tables;
+
+// Decode a group of four values. Reads up to 16 bytes past data, which the
+// slack at the end of the records makes safe
+static inline void decode_group(uint8_t control, const uint8_t *data,
+                                uint32_t *values) {
+#ifdef __SSSE3__
+  __m128i bytes = _mm_loadu_si128((const __m128i *)data);
+  __m128i shuffle = _mm_load_si128((const __m128i *)tables.shuffle[control]);
+  _mm_storeu_si128((__m128i *)values, _mm_shuffle_epi8(bytes, shuffle));
+#else
+  static const uint32_t masks[4] = {0xFF, 0xFFFF, 0xFFFFFF, 0xFFFFFFFF};
+  for (int k = 0; k < 4; k++) {
+    int code = (control >> (2 * k)) & 3;
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    values[k] = value & masks[code];
+    data += code + 1;
+  }
+#endif
+}
+
+static inline uint32_t zigzag(int64_t value) {
+  return (uint32_t)((value << 1) ^ (value >> 63));
+}
+
+static inline int32_t unzigzag(uint32_t value) {
+  return (int32_t)((value >> 1) ^ -(value & 1));
+}
+
+// Call visit on the record offset of every neighbor of the vertex whose record
+// starts at v, until it returns false
+template <typename eidType, typename Visit>
+static inline void for_each_neighbor(const uint32_t *records, eidType v,
+                                     Visit visit) {
+  uint32_t degree = DEGREE(v);
+  const uint8_t *controls = (const uint8_t *)(records + v + 2);
+  const uint8_t *data = controls + (degree + 3) / 4;
+  eidType neighbor = v;
+  uint32_t values[4];
+  for (uint32_t i = 0; i < degree; i += 4) {
+    uint8_t control = controls[i / 4];
+    decode_group(control, data, values);
+    data += tables.length[control];
+    if (i == 0) {
+      // The first neighbor is relative to the vertex itself
+      neighbor += (eidType)(int64_t)unzigzag(values[0]);
+      values[0] = 0;
+    }
+    uint32_t count = std::min(degree - i, 4U);
+    for (uint32_t k = 0; k < count; k++) {
+      neighbor += values[k];
+      if (!visit(neighbor)) {
+        return;
+      }
+    }
+  }
+}
+
+// Encode a sorted neighbor list at out, if not null, and return its length in
+// bytes. Control bytes must be zeroed beforehand
+template <typename eidType>
+static uint64_t encode(uint64_t v, const vidType *neighbors, uint32_t degree,
+                       const uint64_t *offsets, uint8_t *out) {
+  uint64_t length = (degree + 3) / 4;
+  uint8_t *data = out + length;
+  uint64_t previous = v;
+  for (uint32_t j = 0; j < degree; j++) {
+    uint64_t offset = offsets[neighbors[j]];
+    uint32_t value =
+        j == 0 ? zigzag((int64_t)offset - (int64_t)v) : offset - previous;
+    previous = offset;
+    uint32_t code = (value > 0xFF) + (value > 0xFFFF) + (value > 0xFFFFFF);
+    if (out != nullptr) {
+      out[j / 4] |= code << (2 * (j % 4));
+      memcpy(data, &value, code + 1);
+      data += code + 1;
+    }
+    length += code + 1;
+  }
+  return length;
+}
+
+template <typename eidType>
+MergedCSR_Compressed<eidType>::MergedCSR_Compressed(Graph<eidType> *graph)
+    : BFS_Impl<eidType>(graph) {
+  create_records();
+}
+
+template <typename eidType>
+MergedCSR_Compressed<eidType>::~MergedCSR_Compressed() {
+  large_delete(records);
+  large_delete(record_ptr);
+}
+
+// The encoded lists hold record offsets, which depend on the length of the
+// encoded lists. Record sizes start from one byte per value and grow until
+// every list fits; they never shrink, so this converges, usually in 2-3 passes
+template <typename eidType>
+void MergedCSR_Compressed<eidType>::create_records() {
+  const uint64_t N = graph->N;
+  std::unique_ptr<vidType[]> sorted(new vidType[graph->M]);
+  std::unique_ptr<uint32_t[]> sizes(new uint32_t[N]);
+  std::unique_ptr<uint64_t[]> offsets(new uint64_t[N + 1]);
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (vidType v = 0; v < N; v++) {
+    // Sorted by vertex ID means sorted by record offset
+    std::copy(graph->col + graph->rowptr[v], graph->col + graph->rowptr[v + 1],
+              sorted.get() + graph->rowptr[v]);
+    std::sort(sorted.get() + graph->rowptr[v],
+              sorted.get() + graph->rowptr[v + 1]);
+    uint64_t degree = graph->rowptr[v + 1] - graph->rowptr[v];
+    sizes[v] = 2 + ((degree + 3) / 4 + degree + 3) / 4;
+  }
+
+  bool changed = true;
+  while (changed) {
+    offsets[0] = 0;
+    for (vidType v = 0; v < N; v++) {
+      offsets[v + 1] = offsets[v] + sizes[v];
+    }
+    // Deltas are stored in 32 bits and the first one is signed
+    if (offsets[N] + 4 > std::numeric_limits<int32_t>::max()) {
+      throw std::runtime_error(
+          "Error: graph too large for MergedCSR_Compressed");
+    }
+    changed = false;
+#pragma omp parallel for reduction(|| : changed) schedule(dynamic, 1024)
+    for (vidType v = 0; v < N; v++) {
+      uint64_t length =
+          encode<eidType>(offsets[v], sorted.get() + graph->rowptr[v],
+                          graph->rowptr[v + 1] - graph->rowptr[v],
+                          offsets.get(), nullptr);
+      uint32_t needed = 2 + (length + 3) / 4;
+      if (needed > sizes[v]) {
+        sizes[v] = needed;
+        changed = true;
+      }
+    }
+  }
+
+  // 16 bytes of slack for the decoder
+  words = offsets[N] + 4;
+  records = large_new<uint32_t>(words);
+  record_ptr = large_new<eidType>(N + 1);
+#pragma omp parallel for schedule(static)
+  for (vidType v = 0; v < N; v++) {
+    record_ptr[v] = offsets[v];
+    std::fill(records + offsets[v], records + offsets[v + 1], 0);
+    uint32_t degree = graph->rowptr[v + 1] - graph->rowptr[v];
+    DEGREE(offsets[v]) = degree;
+    DISTANCE(offsets[v]) = std::numeric_limits<weight_type>::max();
+    encode<eidType>(offsets[v], sorted.get() + graph->rowptr[v], degree,
+                    offsets.get(), (uint8_t *)(records + offsets[v] + 2));
+  }
+  record_ptr[N] = offsets[N];
+  std::fill(records + offsets[N], records + words, 0);
+}
+
+template <typename eidType>
+void MergedCSR_Compressed<eidType>::compute_distances(weight_type *distances,
+                                                      vidType source) const {
+#pragma omp parallel for simd schedule(static)
+  for (vidType i = 0; i < graph->N; i++) {
+    distances[i] = DISTANCE(record_ptr[i]);
+    // Reset distance for next BFS
+    DISTANCE(record_ptr[i]) = std::numeric_limits<weight_type>::max();
+  }
+  distances[source] = 0;
+}
+
+template <typename eidType>
+void MergedCSR_Compressed<eidType>::top_down_step(
+    const Frontier<eidType> &this_frontier, Frontier<eidType> &next_frontier,
+    const weight_type &distance, eidType &edges_frontier) {
+  PERF_REGION("MergedCSR_Compressed::top_down_step");
+#pragma omp parallel if (this_frontier.size() > 50)
+  {
+    std::vector<eidType> &local_frontier = next_frontier.local();
+#pragma omp for reduction(+ : edges_frontier) schedule(static)
+    for (const auto &v : this_frontier) {
+      for_each_neighbor(records, v, [&](eidType neighbor) {
+        // If neighbor is not visited, add to frontier
+        if (DISTANCE(neighbor) == std::numeric_limits<weight_type>::max()) {
+          if (DEGREE(neighbor) != 1) {
+            local_frontier.push_back(neighbor);
+            edges_frontier += DEGREE(neighbor);
+          }
+          DISTANCE(neighbor) = distance;
+        }
+        return true;
+      });
+    }
+    next_frontier.flush();
+  }
+}
+
+template <typename eidType>
+void MergedCSR_Compressed<eidType>::bottom_up_step(
+    Frontier<eidType> &next_frontier, const weight_type &distance,
+    eidType &edges_frontier) {
+  PERF_REGION("MergedCSR_Compressed::bottom_up_step");
+#pragma omp parallel
+  {
+    std::vector<eidType> &local_frontier = next_frontier.local();
+#pragma omp for reduction(+ : edges_frontier) schedule(static)
+    for (vidType i = 0; i < graph->N; i++) {
+      eidType v = record_ptr[i];
+      if (DISTANCE(v) != std::numeric_limits<weight_type>::max()) {
+        continue;
+      }
+      for_each_neighbor(records, v, [&](eidType neighbor) {
+        if (DISTANCE(neighbor) != distance - 1) {
+          return true;
+        }
+        // If neighbor is in frontier, add this vertex to next frontier
+        if (DEGREE(v) != 1) {
+          local_frontier.push_back(v);
+          edges_frontier += DEGREE(v);
+        }
+        DISTANCE(v) = distance;
+        return false;
+      });
+    }
+    next_frontier.flush();
+  }
+}
+
+template <typename eidType>
+void MergedCSR_Compressed<eidType>::BFS(vidType source,
+                                        weight_type *distances) {
+  PERF_REGION("MergedCSR_Compressed::BFS");
+  TRACE_RUN("MergedCSR_Compressed", source);
+  eidType start = record_ptr[source];
+
+  this_frontier.clear();
+  this_frontier.push_back(start);
+  DISTANCE(start) = 0;
+  weight_type distance = 1;
+  eidType unexplored_edges = graph->M;
+  eidType edges_frontier = DEGREE(start);
+  Direction dir = Direction::TOP_DOWN;
+  while (!this_frontier.empty()) {
+    // Switch direction as in Bitmap::BFS
+    if (dir == Direction::BOTTOM_UP && this_frontier.size() < graph->N / beta) {
+      dir = Direction::TOP_DOWN;
+    } else if (dir == Direction::TOP_DOWN &&
+               edges_frontier > unexplored_edges / alpha) {
+      dir = Direction::BOTTOM_UP;
+    }
+    TRACE_LEVEL_BEGIN(dir, this_frontier.size(), edges_frontier,
+                      unexplored_edges);
+    // Concurrent discoveries may add a vertex to the frontier twice
+    unexplored_edges -= std::min(edges_frontier, unexplored_edges);
+    edges_frontier = 0;
+    next_frontier.clear();
+    if (dir == Direction::TOP_DOWN) {
+      top_down_step(this_frontier, next_frontier, distance, edges_frontier);
+    } else {
+      bottom_up_step(next_frontier, distance, edges_frontier);
+    }
+    TRACE_LEVEL_END();
+    distance++;
+    std::swap(this_frontier, next_frontier);
+  }
+  compute_distances(distances, source);
+}
+
+template <typename eidType>
+bool MergedCSR_Compressed<eidType>::check_result(vidType source,
+                                                 weight_type *distances) {
+  return BFS_Impl<eidType>::check_distances(source, distances);
+}
+
+template class MergedCSR_Compressed<uint32_t>;
+template class MergedCSR_Compressed<uint64_t>;
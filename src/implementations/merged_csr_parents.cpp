@@ -5,83 +5,121 @@
 #define PARENT_ID(vertex) merged_csr[vertex + 1]
 #define DEGREE(vertex) merged_csr[vertex + 2]
 
-MergedCSR_Parents::MergedCSR_Parents(Graph *graph) : BFS_Impl(graph) {
+// The on-disk cache is used as in MergedCSR
+template <typename eidType>
+MergedCSR_Parents<eidType>::MergedCSR_Parents(Graph<eidType> *graph,
+                                              bool use_cache)
+    : BFS_Impl<eidType>(graph) {
+  if (use_cache &&
+      cache.load(graph, MERGED_PARENTS, merged_rowptr, merged_csr)) {
+    return;
+  }
   create_merged_csr();
+  if (use_cache) {
+    MergedCache<eidType>::store(graph, MERGED_PARENTS, merged_rowptr,
+                                merged_csr);
+  }
 }
 
-MergedCSR_Parents::~MergedCSR_Parents() { delete[] merged_csr; }
+template <typename eidType>
+MergedCSR_Parents<eidType>::~MergedCSR_Parents() {
+  if (!cache.is_mapped()) {
+    large_delete(merged_csr);
+    large_delete(merged_rowptr);
+  }
+}
 
-// Create merged CSR from CSR
-void MergedCSR_Parents::create_merged_csr() {
-  merged_csr = new eidType[graph->M + 3 * graph->N];
-  merged_rowptr = new eidType[graph->N];
+// Create merged CSR from CSR. Every thread fills its own range of vertices,
+// starting at rowptr[i] + 3 * i, so that the pages of each range are first
+// touched by the thread that owns it under schedule(static)
+template <typename eidType>
+void MergedCSR_Parents<eidType>::create_merged_csr() {
+  merged_csr = large_new<eidType>(graph->M + 3 * graph->N);
+  merged_rowptr = large_new<eidType>(graph->N + 1);
 
-  vidType merged_index = 0;
+#pragma omp parallel for schedule(static)
   for (vidType i = 0; i < graph->N; i++) {
-    vidType start = graph->rowptr[i];
+    eidType start = graph->rowptr[i];
+    eidType merged_index = start + 3 * (eidType)i;
+    // Fix rowptr indices by adding offset caused by adding the degree to the
+    // start of each neighbor list
+    merged_rowptr[i] = merged_index;
     // Add vertex ID to start of neighbor list
     merged_csr[merged_index++] = i;
     // Add parent ID to start of neighbor list (initialized to -1)
     merged_csr[merged_index++] = -1;
     // Add degree to start of neighbor list
-    merged_csr[merged_index++] = graph->rowptr[i + 1] - graph->rowptr[i];
+    merged_csr[merged_index++] = graph->rowptr[i + 1] - start;
     // Copy neighbors
-    for (vidType j = start; j < graph->rowptr[i + 1]; j++) {
+    for (eidType j = start; j < graph->rowptr[i + 1]; j++) {
       merged_csr[merged_index++] =
-          graph->rowptr[graph->col[j]] + 3 * graph->col[j];
+          graph->rowptr[graph->col[j]] + 3 * (eidType)graph->col[j];
     }
   }
-  // Fix rowptr indices by adding offset caused by adding the degree to the
-  // start of each neighbor list
-  for (vidType i = 0; i <= graph->N; i++) {
-    merged_rowptr[i] = graph->rowptr[i] + 3 * i;
-  }
+  merged_rowptr[graph->N] = graph->M + 3 * graph->N;
 }
 
-void MergedCSR_Parents::compute_parents(weight_type *parents,
-                                        vidType source) const {
+template <typename eidType>
+void MergedCSR_Parents<eidType>::compute_parents(weight_type *parents,
+                                                 vidType source) const {
 #pragma omp parallel for simd schedule(static)
   for (vidType i = 0; i < graph->N; i++) {
     parents[i] = merged_csr[merged_rowptr[i] + 1];
+    // Reset parent for next BFS
+    merged_csr[merged_rowptr[i] + 1] = -1;
   }
 }
 
-#pragma omp declare reduction(vec_add : std::vector<eidType> : omp_out.insert( \
-        omp_out.end(), omp_in.begin(), omp_in.end()))
-
-void MergedCSR_Parents::top_down_step(const frontier &this_frontier,
-                                      frontier &next_frontier) {
-#pragma omp parallel for reduction(vec_add : next_frontier)                    \
-    schedule(static) if (this_frontier.size() > 50)
-  for (const auto &v : this_frontier) {
-    vidType end = v + DEGREE(v) + 3;
-    for (eidType i = v + 3; i < end; i++) {
-      eidType neighbor = merged_csr[i];
-      if (PARENT_ID(neighbor) == -1) {
-        if (DEGREE(neighbor) != 1) {
-          next_frontier.push_back(neighbor);
+template <typename eidType>
+void MergedCSR_Parents<eidType>::top_down_step(
+    const Frontier<eidType> &this_frontier, Frontier<eidType> &next_frontier) {
+  PERF_REGION("MergedCSR_Parents::top_down_step");
+#pragma omp parallel if (this_frontier.size() > 50)
+  {
+    std::vector<eidType> &local_frontier = next_frontier.local();
+#pragma omp for schedule(static)
+    for (const auto &v : this_frontier) {
+      eidType end = v + DEGREE(v) + 3;
+      for (eidType i = v + 3; i < end; i++) {
+        eidType neighbor = merged_csr[i];
+        if (PARENT_ID(neighbor) == -1) {
+          if (DEGREE(neighbor) != 1) {
+            local_frontier.push_back(neighbor);
+          }
+          PARENT_ID(neighbor) = VERTEX_ID(v);
         }
-        PARENT_ID(neighbor) = VERTEX_ID(v);
       }
     }
+    next_frontier.flush();
   }
 }
 
-void MergedCSR_Parents::BFS(vidType source, weight_type *parents) {
-  frontier this_frontier = {};
+template <typename eidType>
+void MergedCSR_Parents<eidType>::BFS(vidType source,
+                                     weight_type *parents) {
+  PERF_REGION("MergedCSR_Parents::BFS");
+  TRACE_RUN("MergedCSR_Parents", source);
   eidType start = merged_rowptr[source];
 
+  this_frontier.clear();
   this_frontier.push_back(start);
   PARENT_ID(start) = source;
   while (!this_frontier.empty()) {
-    frontier next_frontier;
-    next_frontier.reserve(this_frontier.size());
+    next_frontier.clear();
+    TRACE_LEVEL_BEGIN(TOP_DOWN, this_frontier.size(), TRACE_UNKNOWN,
+                      TRACE_UNKNOWN);
     top_down_step(this_frontier, next_frontier);
-    this_frontier = std::move(next_frontier);
+    TRACE_LEVEL_END();
+    std::swap(this_frontier, next_frontier);
   }
   compute_parents(parents, source);
 }
 
-bool MergedCSR_Parents::check_result(vidType source, weight_type *parents) {
-  return BFS_Impl::check_parents(source, parents);
-}
\ No newline at end of file
+template <typename eidType>
+bool MergedCSR_Parents<eidType>::check_result(vidType source,
+                                              weight_type *parents) {
+  return BFS_Impl<eidType>::check_parents(source, parents);
+}
+
+template class MergedCSR_Parents<uint32_t>;
+template class MergedCSR_Parents<uint64_t>;
@@ -0,0 +1,167 @@
+#include "graph.hpp"
+#include <atomic>
+
+#define BITS(array, vertex) (array + (uint64_t)(vertex) * batch_words)
+
+template <typename eidType>
+MultiSource<eidType>::MultiSource(Graph<eidType> *graph, uint32_t batch_words)
+    : BFS_Impl<eidType>(graph), batch_words(batch_words),
+      seen(large_new<uint64_t>(graph->N * batch_words)),
+      visit(large_new<uint64_t>(graph->N * batch_words)),
+      visit_next(large_new<uint64_t>(graph->N * batch_words)),
+      in_next(large_new<bool>(graph->N)) {
+#pragma omp parallel for schedule(static)
+  for (vidType i = 0; i < graph->N; i++) {
+    for (uint32_t w = 0; w < batch_words; w++) {
+      BITS(seen, i)[w] = 0;
+      BITS(visit, i)[w] = 0;
+      BITS(visit_next, i)[w] = 0;
+    }
+    in_next[i] = false;
+  }
+}
+
+template <typename eidType>
+MultiSource<eidType>::~MultiSource() {
+  large_delete(seen);
+  large_delete(visit);
+  large_delete(visit_next);
+  large_delete(in_next);
+}
+
+// Propagate the searches active on each frontier vertex to its neighbors. Each
+// adjacency list is read once for all the searches in the batch
+template <typename eidType>
+void MultiSource<eidType>::top_down_step(
+    const Frontier<vidType> &this_frontier, Frontier<vidType> &next_frontier) {
+  PERF_REGION("MultiSource::top_down_step");
+#pragma omp parallel if (this_frontier.size() > 50)
+  {
+    std::vector<vidType> &local_frontier = next_frontier.local();
+#pragma omp for schedule(static)
+    for (const auto &v : this_frontier) {
+      const uint64_t *visit_v = BITS(visit, v);
+      for (eidType i = graph->rowptr[v]; i < graph->rowptr[v + 1]; i++) {
+        vidType neighbor = graph->col[i];
+        const uint64_t *seen_n = BITS(seen, neighbor);
+        uint64_t *next_n = BITS(visit_next, neighbor);
+        bool discovered = false;
+        for (uint32_t w = 0; w < batch_words; w++) {
+          uint64_t bits = visit_v[w] & ~seen_n[w];
+          // Other threads set bits of visit_next and in_next concurrently,
+          // so they are only accessed atomically
+          std::atomic_ref<uint64_t> next_word(next_n[w]);
+          if (bits != 0 &&
+              (next_word.load(std::memory_order_relaxed) & bits) != bits) {
+            next_word.fetch_or(bits, std::memory_order_relaxed);
+            discovered = true;
+          }
+        }
+        // Add the neighbor to the next frontier only once
+        std::atomic_ref<bool> neighbor_in_next(in_next[neighbor]);
+        if (discovered &&
+            !neighbor_in_next.load(std::memory_order_relaxed) &&
+            !neighbor_in_next.exchange(true, std::memory_order_relaxed)) {
+          local_frontier.push_back(neighbor);
+        }
+      }
+    }
+    next_frontier.flush();
+  }
+}
+
+// Mark the searches that reached each vertex of the next frontier as seen and
+// record their distances
+template <typename eidType>
+void MultiSource<eidType>::update_frontier(
+    const Frontier<vidType> &this_frontier,
+    const Frontier<vidType> &next_frontier, weight_type distance,
+    weight_type **distances) {
+  PERF_REGION("MultiSource::update_frontier");
+#pragma omp parallel
+  {
+#pragma omp for schedule(static)
+    for (const auto &v : this_frontier) {
+      for (uint32_t w = 0; w < batch_words; w++) {
+        BITS(visit, v)[w] = 0;
+      }
+    }
+#pragma omp for schedule(static)
+    for (const auto &v : next_frontier) {
+      uint64_t *next_v = BITS(visit_next, v);
+      for (uint32_t w = 0; w < batch_words; w++) {
+        uint64_t bits = next_v[w];
+        BITS(seen, v)[w] |= bits;
+        BITS(visit, v)[w] = bits;
+        next_v[w] = 0;
+        while (bits != 0) {
+          distances[w * 64 + __builtin_ctzll(bits)][v] = distance;
+          bits &= bits - 1;
+        }
+      }
+      in_next[v] = false;
+    }
+  }
+}
+
+template <typename eidType>
+void MultiSource<eidType>::run_batch(const vidType *sources,
+                                     uint32_t num_sources,
+                                     weight_type **distances) {
+  PERF_REGION("MultiSource::run_batch");
+  TRACE_RUN("MultiSource", sources[0]);
+  this_frontier.clear();
+  for (uint32_t s = 0; s < num_sources; s++) {
+    vidType source = sources[s];
+    if (!in_next[source]) {
+      in_next[source] = true;
+      this_frontier.push_back(source);
+    }
+    BITS(seen, source)[s / 64] |= 1ULL << (s % 64);
+    BITS(visit, source)[s / 64] |= 1ULL << (s % 64);
+    distances[s][source] = 0;
+  }
+  for (const auto &v : this_frontier) {
+    in_next[v] = false;
+  }
+  weight_type distance = 1;
+  while (!this_frontier.empty()) {
+    next_frontier.clear();
+    TRACE_LEVEL_BEGIN(TOP_DOWN, this_frontier.size(), TRACE_UNKNOWN,
+                      TRACE_UNKNOWN);
+    top_down_step(this_frontier, next_frontier);
+    update_frontier(this_frontier, next_frontier, distance, distances);
+    TRACE_LEVEL_END();
+    distance++;
+    std::swap(this_frontier, next_frontier);
+  }
+  // Reset seen bits for the next batch
+#pragma omp parallel for schedule(static)
+  for (uint64_t i = 0; i < graph->N * batch_words; i++) {
+    seen[i] = 0;
+  }
+}
+
+template <typename eidType>
+void MultiSource<eidType>::BFS(const std::vector<vidType> &sources,
+                               weight_type **distances) {
+  for (size_t start = 0; start < sources.size(); start += batch_size()) {
+    uint32_t num_sources =
+        std::min<size_t>(batch_size(), sources.size() - start);
+    run_batch(sources.data() + start, num_sources, distances + start);
+  }
+}
+
+template <typename eidType>
+void MultiSource<eidType>::BFS(vidType source, weight_type *distances) {
+  run_batch(&source, 1, &distances);
+}
+
+template <typename eidType>
+bool MultiSource<eidType>::check_result(vidType source,
+                                        weight_type *distances) {
+  return BFS_Impl<eidType>::check_distances(source, distances);
+}
+
+template class MultiSource<uint32_t>;
+template class MultiSource<uint64_t>;
@@ -1,15 +1,23 @@
 #include <graph.hpp>
 
-Reference::Reference(Graph *graph) : BFS_Impl(graph) {}
+template <typename eidType>
+Reference<eidType>::Reference(Graph<eidType> *graph, bool owns_graph)
+    : BFS_Impl<eidType>(graph, owns_graph) {}
 
-Reference::~Reference() {}
+template <typename eidType>
+Reference<eidType>::~Reference() {}
 
-void Reference::BFS(vidType source, weight_type *distances) {
+template <typename eidType>
+void Reference<eidType>::BFS(vidType source, weight_type *distances) {
+  PERF_REGION("Reference::BFS");
+  TRACE_RUN("Reference", source);
   std::vector<vidType> this_frontier = {};
   distances[source] = 0;
   this_frontier.push_back(source);
   while (!this_frontier.empty()) {
     std::vector<vidType> next_frontier;
+    TRACE_LEVEL_BEGIN(TOP_DOWN, this_frontier.size(), TRACE_UNKNOWN,
+                      TRACE_UNKNOWN);
     for (const auto &src : this_frontier) {
       for (uint64_t i = graph->rowptr[src]; i < graph->rowptr[src + 1]; i++) {
         vidType dst = graph->col[i];
@@ -19,10 +27,15 @@ void Reference::BFS(vidType source, weight_type *distances) {
         }
       }
     }
+    TRACE_LEVEL_END();
     std::swap(this_frontier, next_frontier);
   }
 }
 
-bool Reference::check_result(vidType source, weight_type *distances) {
-  return BFS_Impl::check_distances(source, distances);
-}
\ No newline at end of file
+template <typename eidType>
+bool Reference<eidType>::check_result(vidType source, weight_type *distances) {
+  return BFS_Impl<eidType>::check_distances(source, distances);
+}
+
+template class Reference<uint32_t>;
+template class Reference<uint64_t>;
@@ -0,0 +1,176 @@
+#include "graph.hpp"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+#define UNREACHED std::numeric_limits<weight_type>::max()
+
+template <typename eidType>
+Sparse<eidType>::Sparse(Graph<eidType> *graph)
+    : BFS_Impl<eidType>(graph), depth(large_new<weight_type>(graph->N)),
+      parent(large_new<vidType>(graph->N)) {
+#pragma omp parallel for schedule(static)
+  for (vidType i = 0; i < graph->N; i++) {
+    depth[i] = UNREACHED;
+  }
+}
+
+template <typename eidType>
+Sparse<eidType>::~Sparse() {
+  large_delete(depth);
+  large_delete(parent);
+}
+
+// Set the depth of v if it is unreached. Top-down steps discover a vertex from
+// several frontier vertices at once, so only the thread that wins the exchange
+// adds it to the reached vertices and sets its parent
+template <typename eidType>
+inline bool Sparse<eidType>::claim(vidType v, vidType from,
+                                   weight_type distance) {
+  std::atomic_ref<weight_type> v_depth(depth[v]);
+  weight_type unreached = UNREACHED;
+  if (v_depth.load(std::memory_order_relaxed) != unreached ||
+      !v_depth.compare_exchange_strong(unreached, distance,
+                                       std::memory_order_relaxed)) {
+    return false;
+  }
+  parent[v] = from;
+  return true;
+}
+
+// Expand the level stored in reached[begin, end), appending the next level
+template <typename eidType>
+void Sparse<eidType>::top_down_step(size_t begin, size_t end,
+                                    weight_type distance,
+                                    eidType &edges_frontier,
+                                    eidType edges_frontier_old) {
+  PERF_REGION("Sparse::top_down_step");
+  heavy.clear();
+#pragma omp parallel if (edges_frontier_old > 150)
+  {
+    std::vector<vidType> &local_reached = reached.local();
+    // Takes the reduction variable, which is private to each loop
+    auto visit = [&](vidType v, eidType first, eidType last, eidType &edges) {
+      for (eidType i = first; i < last; i++) {
+        vidType neighbor = graph->col[i];
+        if (claim(neighbor, v, distance)) {
+          local_reached.push_back(neighbor);
+          edges += graph->rowptr[neighbor + 1] - graph->rowptr[neighbor];
+        }
+      }
+    };
+    std::vector<EdgeChunk<eidType>> &local_heavy = heavy.local();
+#pragma omp for reduction(+ : edges_frontier) schedule(static)
+    for (size_t f = begin; f < end; f++) {
+      vidType v = reached[f];
+      if (graph->rowptr[v + 1] - graph->rowptr[v] > HEAVY_DEGREE) {
+        split_edges(local_heavy, graph->rowptr[v], graph->rowptr[v + 1]);
+      } else {
+        visit(v, graph->rowptr[v], graph->rowptr[v + 1], edges_frontier);
+      }
+    }
+    heavy.flush();
+#pragma omp for reduction(+ : edges_frontier) schedule(dynamic, 1)
+    for (const auto &chunk : heavy) {
+      // Vertex owning the chunk, for the parents
+      vidType v = std::upper_bound(graph->rowptr, graph->rowptr + graph->N + 1,
+                                   chunk.begin) -
+                  graph->rowptr - 1;
+      visit(v, chunk.begin, chunk.end, edges_frontier);
+    }
+    reached.flush();
+  }
+}
+
+// Bottom-up step: every unreached vertex looks for a neighbor of the previous
+// level. Only the thread owning a vertex writes it, so no exchange is needed
+template <typename eidType>
+void Sparse<eidType>::bottom_up_step(weight_type distance,
+                                     eidType &edges_frontier) {
+  PERF_REGION("Sparse::bottom_up_step");
+#pragma omp parallel
+  {
+    std::vector<vidType> &local_reached = reached.local();
+#pragma omp for reduction(+ : edges_frontier) schedule(static)
+    for (vidType i = 0; i < graph->N; i++) {
+      if (depth[i] == UNREACHED) {
+        for (eidType j = graph->rowptr[i]; j < graph->rowptr[i + 1]; j++) {
+          if (depth[graph->col[j]] == distance - 1) {
+            depth[i] = distance;
+            parent[i] = graph->col[j];
+            local_reached.push_back(i);
+            edges_frontier += graph->rowptr[i + 1] - graph->rowptr[i];
+            break;
+          }
+        }
+      }
+    }
+    reached.flush();
+  }
+}
+
+template <typename eidType>
+void Sparse<eidType>::reset() {
+#pragma omp parallel for schedule(static) if (reached.size() > 1000)
+  for (const auto &v : reached) {
+    depth[v] = UNREACHED;
+  }
+  reached.clear();
+}
+
+// Each level is the range of reached appended by the previous step, so the
+// reached vertices are known without a sweep. Bottom-up steps still scan all
+// vertices, but only run when the frontier holds a large share of the edges
+template <typename eidType>
+void Sparse<eidType>::query(vidType source) {
+  PERF_REGION("Sparse::BFS");
+  TRACE_RUN("Sparse", source);
+  reset();
+  reached.push_back(source);
+  depth[source] = 0;
+  parent[source] = source;
+  size_t begin = 0;
+  weight_type distance = 1;
+  eidType unexplored_edges = graph->M;
+  eidType edges_frontier = graph->rowptr[source + 1] - graph->rowptr[source];
+  Direction dir = Direction::TOP_DOWN;
+  while (begin < reached.size()) {
+    size_t end = reached.size();
+    // Switch direction as in Bitmap::BFS
+    if (dir == Direction::BOTTOM_UP && end - begin < graph->N / beta) {
+      dir = Direction::TOP_DOWN;
+    } else if (dir == Direction::TOP_DOWN &&
+               edges_frontier > unexplored_edges / alpha) {
+      dir = Direction::BOTTOM_UP;
+    }
+    TRACE_LEVEL_BEGIN(dir, end - begin, edges_frontier, unexplored_edges);
+    unexplored_edges -= edges_frontier;
+    eidType edges_frontier_old = edges_frontier;
+    edges_frontier = 0;
+    if (dir == Direction::TOP_DOWN) {
+      top_down_step(begin, end, distance, edges_frontier, edges_frontier_old);
+    } else {
+      bottom_up_step(distance, edges_frontier);
+    }
+    TRACE_LEVEL_END();
+    distance++;
+    begin = end;
+  }
+}
+
+template <typename eidType>
+void Sparse<eidType>::BFS(vidType source, weight_type *distances) {
+  query(source);
+#pragma omp parallel for schedule(static) if (reached.size() > 1000)
+  for (const auto &v : reached) {
+    distances[v] = depth[v];
+  }
+}
+
+template <typename eidType>
+bool Sparse<eidType>::check_result(vidType source, weight_type *distances) {
+  return BFS_Impl<eidType>::check_distances(source, distances);
+}
+
+template class Sparse<uint32_t>;
+template class Sparse<uint64_t>;
@@ -1,73 +1,443 @@
+#include "benchmark.hpp"
+#include "calibrate.hpp"
+#include "distributed.hpp"
 #include "graph.hpp"
+#include "numa_placement.hpp"
+#include "selector.hpp"
+#include "server.hpp"
 #include <algorithm>
+#include <fstream>
 #include <limits>
+#include <map>
+#include <stdexcept>
 #include <omp.h>
 #include <string>
 
 #define USAGE                                                                  \
-  "Usage: %s <schema> <source> <implementation> <check>\nRuns BFS "            \
+  "Usage: %s <schema> <source> <implementation> <check> [options]\nRuns BFS " \
   "implementations. \n\nMandatory arguments:\n  <schema>\t path to JSON "      \
   "schema of dataset \n  <source>\t : integer. Source vertex ID "              \
   "('0' by default) \n  <algorithm>\t : 'merged_csr_parents', 'merged_csr', "  \
-  "'bitmap', 'classic', 'reference', 'heuristic' ('heuristic' by default) \n " \
-  " <check>\t : 'true', false'. Checks correctness of the result ('false' by " \
-  "default)\n"
+  "'merged_csr_compressed', 'bitmap', 'classic', 'sparse', 'reference', "      \
+  "'multi_source', 'distributed', 'delta_stepping', 'heuristic' "              \
+  "('heuristic' by default). 'multi_source' runs every source listed in the "  \
+  "schema. 'distributed' runs on all MPI ranks (builds with -DBFS_MPI=ON). "   \
+  "'delta_stepping' computes weighted distances on a weighted dataset "        \
+  "\n  <check>\t : 'true', false'. Checks correctness of the result "   \
+  "('false' by default)\n"
 
-BFS_Impl *initialize_BFS(std::string filename, std::string algo_str) {
-  std::string path = "schemas/" + filename;
-  Graph *graph = new Graph(path);
+#define OPTIONS_USAGE                                                          \
+  "\nOptions:\n"                                                               \
+  "  --load=<mode>\t : 'read', 'mmap', 'mmap_populate'. How binary datasets "  \
+  "are loaded ('mmap' by default)\n"                                           \
+  "  --index=<width>\t : 'auto', '32', '64'. Width of edge indices ('auto' "   \
+  "picks 32 bits when the graph fits)\n"                                       \
+  "  --merged_cache\t : map the MergedCSR layout from its on-disk cache next " \
+  "to the dataset, creating the cache if missing\n"                          \
+  "  --order=<ordering>\t : 'none', 'degree', 'rcm', 'bfs'. Relabel the "     \
+  "vertices before building the engine ('none' by default)\n"                 \
+  "  --output=<file>\t : write the result of a single-source run, one value " \
+  "per original vertex ID\n"                                                  \
+  "  --numa=<mode>\t : 'off', 'interleave', 'partition'. NUMA placement of "  \
+  "the graph and engine arrays; pins the threads ('off' by default)\n"       \
+  "  --pages=<mode>\t : 'default', 'thp', 'hugetlb'. Page backing of the "     \
+  "graph and engine arrays ('thp' by default)\n"                              \
+  "  --benchmark[=<list>]\t : compare the comma-separated implementations "   \
+  "('merged_csr,bitmap,classic,heuristic' by default) from every source of "  \
+  "the schema, ignoring <source> and <algorithm>\n"                          \
+  "  --sources=<n>\t : run --benchmark from n random non-isolated sources "   \
+  "instead of the schema's (64 if the schema lists none)\n"                  \
+  "  --warmup=<n>, --trials=<n>\t : untimed and timed runs per source (1 "   \
+  "and 5 by default)\n"                                                      \
+  "  --seed=<n>\t : seed of the random source selection (1 by default)\n"    \
+  "  --report=<file>\t : write the benchmark results as CSV (.csv) or JSON\n" \
+  "  --perf=<file>\t : write the hardware counters of each engine and step "  \
+  "as CSV (builds with -DBFS_PERF=ON)\n"                                      \
+  "  --trace=<file>\t : write per-level statistics of every traversal as "    \
+  "CSV (.csv) or JSON (builds with -DBFS_TRACE=ON)\n"                         \
+  "  --selector_cache\t : reuse the choice of 'heuristic' stored in "         \
+  "schemas/<name>.tuning.json, storing it there if missing\n"                \
+  "  --alpha=<n>, --beta=<n>\t : direction switch thresholds (4 and 24, or "  \
+  "the calibrated ones, by default)\n"                                        \
+  "  --calibrate\t : search the thresholds for the dataset and machine, and "  \
+  "store them in schemas/<name>.tuning.json\n"                               \
+  "  --serve[=<socket>]\t : load the graph once and answer '<source> "         \
+  "[distances|parents]' queries from stdin, or from the given Unix socket, "  \
+  "with the 'sparse' engine, ignoring <source> and <algorithm>\n"              \
+  "  --target=<n>\t : print the distance from <source> to n, found by a "     \
+  "bidirectional search, ignoring <algorithm>\n"                              \
+  "  --delta=<n>\t : bucket width of 'delta_stepping' (the mean edge weight " \
+  "by default)\n"                                                            \
+  "  --simd=<level>\t : 'auto', 'avx512', 'avx2', 'scalar'. Top-down kernel " \
+  "of 'merged_csr' ('auto' picks the best one of the CPU)\n"
 
+typedef std::map<std::string, std::string> Options;
+
+// Split command line arguments into positional arguments and --key=value
+// options
+std::vector<std::string> parse_args(const int argc, char **argv,
+                                    Options &options) {
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind("--", 0) == 0) {
+      size_t eq = arg.find('=');
+      options[arg.substr(2, eq - 2)] =
+          eq == std::string::npos ? "true" : arg.substr(eq + 1);
+    } else {
+      args.push_back(arg);
+    }
+  }
+  return args;
+}
+
+std::string get_option(const Options &options, const std::string &key,
+                       const std::string &default_value) {
+  auto it = options.find(key);
+  return it == options.end() ? default_value : it->second;
+}
+
+// Settings given through --key=value options
+struct Config {
+  LoadMode load_mode;
+  std::string index;
+  bool merged_cache;
+  Ordering ordering;
+  std::string output;
+  NumaMode numa;
+  PageMode pages;
+  bool benchmark;
+  BenchmarkConfig bench;
+  std::string perf;
+  std::string trace;
+  bool selector_cache;
+  uint32_t alpha;
+  uint32_t beta;
+  bool calibrate;
+  bool serve;
+  std::string socket; // Unix socket of the server (empty: stdin)
+  int64_t target;     // Target of a point-to-point query (-1: none)
+  uint32_t delta;     // Bucket width of delta-stepping (0: mean weight)
+  SimdLevel simd;     // Top-down kernel of MergedCSR
+  std::string schema_path;
+};
+
+LoadMode parse_load_mode(const std::string &mode) {
+  if (mode == "read") {
+    return LoadMode::READ;
+  } else if (mode == "mmap") {
+    return LoadMode::MMAP;
+  } else if (mode == "mmap_populate") {
+    return LoadMode::MMAP_POPULATE;
+  }
+  throw std::invalid_argument("Unknown load mode " + mode);
+}
+
+NumaMode parse_numa_mode(const std::string &mode) {
+  if (mode == "off") {
+    return NUMA_OFF;
+  } else if (mode == "interleave") {
+    return NUMA_INTERLEAVE;
+  } else if (mode == "partition") {
+    return NUMA_PARTITION;
+  }
+  throw std::invalid_argument("Unknown NUMA mode " + mode);
+}
+
+PageMode parse_page_mode(const std::string &mode) {
+  if (mode == "default") {
+    return PAGES_DEFAULT;
+  } else if (mode == "thp") {
+    return PAGES_THP;
+  } else if (mode == "hugetlb") {
+    return PAGES_HUGETLB;
+  }
+  throw std::invalid_argument("Unknown page mode " + mode);
+}
+
+Ordering parse_ordering(const std::string &ordering) {
+  for (Ordering o : {ORDER_NONE, ORDER_DEGREE, ORDER_RCM, ORDER_BFS}) {
+    if (ordering == ordering_name(o)) {
+      return o;
+    }
+  }
+  throw std::invalid_argument("Unknown ordering " + ordering);
+}
+
+Config parse_config(const Options &options) {
+  Config config;
+  config.load_mode = parse_load_mode(get_option(options, "load", "mmap"));
+  config.index = get_option(options, "index", "auto");
+  if (config.index != "auto" && config.index != "32" && config.index != "64") {
+    throw std::invalid_argument("Unknown index width " + config.index);
+  }
+  config.merged_cache = get_option(options, "merged_cache", "false") == "true";
+  config.ordering = parse_ordering(get_option(options, "order", "none"));
+  config.output = get_option(options, "output", "");
+  config.numa = parse_numa_mode(get_option(options, "numa", "off"));
+  config.pages = parse_page_mode(get_option(options, "pages", "thp"));
+
+  std::string engines = get_option(options, "benchmark", "false");
+  config.benchmark = engines != "false";
+  if (engines == "true" || engines == "false") {
+    engines = "merged_csr,bitmap,classic,heuristic";
+  }
+  for (size_t pos = 0; pos <= engines.size();) {
+    size_t end = std::min(engines.find(',', pos), engines.size());
+    config.bench.engines.push_back(engines.substr(pos, end - pos));
+    pos = end + 1;
+  }
+  config.bench.num_sources = std::stoul(get_option(options, "sources", "0"));
+  config.bench.warmup = std::stoul(get_option(options, "warmup", "1"));
+  config.bench.trials = std::stoul(get_option(options, "trials", "5"));
+  config.bench.seed = std::stoull(get_option(options, "seed", "1"));
+  config.bench.report = get_option(options, "report", "");
+  config.perf = get_option(options, "perf", "");
+  config.trace = get_option(options, "trace", "");
+  config.selector_cache =
+      get_option(options, "selector_cache", "false") == "true";
+  config.alpha = std::stoul(get_option(options, "alpha", "0"));
+  config.beta = std::stoul(get_option(options, "beta", "0"));
+  config.calibrate = get_option(options, "calibrate", "false") == "true";
+  std::string serve = get_option(options, "serve", "false");
+  config.serve = serve != "false";
+  config.socket = serve == "true" || serve == "false" ? "" : serve;
+  config.target = std::stoll(get_option(options, "target", "-1"));
+  config.delta = std::stoul(get_option(options, "delta", "0"));
+  config.simd = parse_simd_level(get_option(options, "simd", "auto"));
+  return config;
+}
+
+// Load the graph, applying the relabeling requested in the configuration
+template <typename eidType>
+Graph<eidType> *load_graph(std::string &path, const Config &config) {
+  Graph<eidType> *graph = new Graph<eidType>(path, config.load_mode);
+  if (config.ordering != ORDER_NONE) {
+    double t_start = omp_get_wtime();
+    graph->reorder(config.ordering);
+    printf("Reordering (%s): %f\n", ordering_name(config.ordering),
+           omp_get_wtime() - t_start);
+  }
+  return graph;
+}
+
+template <typename eidType>
+BFS_Impl<eidType> *new_engine(Graph<eidType> *graph,
+                              const std::string &algo_str,
+                              const Config &config) {
   if (algo_str == "merged_csr_parents") {
-    return new MergedCSR_Parents(graph);
+    return new MergedCSR_Parents<eidType>(graph, config.merged_cache);
   } else if (algo_str == "merged_csr") {
-    return new MergedCSR(graph);
+    MergedCSR<eidType> *merged_csr =
+        new MergedCSR<eidType>(graph, config.merged_cache);
+    merged_csr->set_simd(config.simd);
+    return merged_csr;
+  } else if (algo_str == "merged_csr_compressed") {
+    return new MergedCSR_Compressed<eidType>(graph);
   } else if (algo_str == "bitmap") {
-    return new Bitmap(graph);
+    return new Bitmap<eidType>(graph);
   } else if (algo_str == "classic") {
-    return new Classic(graph);
+    return new Classic<eidType>(graph);
+  } else if (algo_str == "sparse") {
+    return new Sparse<eidType>(graph);
+#ifdef BFS_MPI
+  } else if (algo_str == "distributed") {
+    return new Distributed<eidType>(graph);
+#endif
+  } else if (algo_str == "delta_stepping") {
+    return new DeltaStepping<eidType>(graph, config.delta);
   } else if (algo_str == "reference") {
-    return new Reference(graph);
+    return new Reference<eidType>(graph);
+  } else if (algo_str == "multi_source") {
+    uint32_t batch_words = std::clamp<uint32_t>(
+        (graph->sources.size() + 63) / 64, 1, MS_BFS_MAX_WORDS);
+    return new MultiSource<eidType>(graph, batch_words);
   } else {
-    if ((float)(graph->M) / graph->N < 10) { // Graph diameter heuristic
-      return new MergedCSR(graph);
-    } else {
-      return new Bitmap(graph);
+    EngineChoice choice =
+        select_engine(graph, config.schema_path, config.selector_cache);
+    return new_engine(graph, choice.engine, config);
+  }
+}
+
+// Build the engine and set its direction switch thresholds: the ones given on
+// the command line, or else the calibrated ones stored for the dataset
+template <typename eidType>
+BFS_Impl<eidType> *make_engine(Graph<eidType> *graph,
+                               const std::string &algo_str,
+                               const Config &config) {
+  BFS_Impl<eidType> *bfs = new_engine(graph, algo_str, config);
+  if (config.alpha != 0 || config.beta != 0) {
+    bfs->alpha = config.alpha != 0 ? config.alpha : ALPHA;
+    bfs->beta = config.beta != 0 ? config.beta : BETA;
+  } else if (!config.calibrate && load_thresholds(bfs, config.schema_path)) {
+    printf("Thresholds: alpha %u, beta %u (calibrated)\n", bfs->alpha,
+           bfs->beta);
+  }
+  return bfs;
+}
+
+template <typename eidType>
+BFS_Impl<eidType> *initialize_BFS(std::string &path, std::string &algo_str,
+                                  const Config &config) {
+#ifdef BFS_MPI
+  // Each distributed rank reads only its own rows of a binary dataset. When
+  // the graph has to be loaded whole (COO datasets, reordering) it is released
+  // once the rows are copied. Calibration still needs the whole graph
+  if (algo_str == "distributed" && !config.calibrate) {
+    Config rows_config = config;
+    if (config.ordering == ORDER_NONE) {
+      rows_config.load_mode = LoadMode::HEADER;
     }
+    Graph<eidType> *graph = load_graph<eidType>(path, rows_config);
+    BFS_Impl<eidType> *bfs = make_engine(graph, algo_str, config);
+    graph->release_storage();
+    return bfs;
   }
+#endif
+  return make_engine(load_graph<eidType>(path, config), algo_str, config);
 }
 
-int main(const int argc, char **argv) {
-  if (argc < 2 || argc > 5) {
-    printf(USAGE, argv[0]);
-    return 1;
+// Run a BFS from every source listed in the schema (or from the given source if
+// the schema has none) with the multi-source engine
+template <typename eidType>
+int run_multi_source(MultiSource<eidType> *bfs, vidType source, bool check) {
+  std::vector<vidType> sources = bfs->graph->sources;
+  if (sources.empty()) {
+    sources.push_back(source);
   }
-  vidType source = 0;
-  bool check = false;
+  for (auto &s : sources) {
+    s = bfs->graph->internal_id(s);
+  }
+  printf("Number of sources: %zu (batch size %u)\n", sources.size(),
+         bfs->batch_size());
 
-  if (argc > 2) {
-    source = std::stoi(argv[2]);
+  std::vector<weight_type *> results(sources.size());
+  for (auto &result : results) {
+    result = large_new<weight_type>(bfs->graph->N);
+    std::fill_n(result, bfs->graph->N,
+                std::numeric_limits<weight_type>::max());
   }
-  if (argc > 4) {
-    std::string check_str = argv[4];
-    if (check_str == "true") {
-      check = true;
+
+  double t_start = omp_get_wtime();
+  bfs->BFS(sources, results.data());
+  double t_end = omp_get_wtime();
+
+  printf("Runtime: %f\n", t_end - t_start);
+
+  bool correct = true;
+  for (size_t s = 0; s < sources.size(); s++) {
+    if (check) {
+      correct &= bfs->check_result(sources[s], results[s]);
     }
+    large_delete(results[s]);
   }
+  return correct ? 0 : 1;
+}
 
-#pragma omp parallel
-  {
-#pragma omp master
-    { printf("Number of threads: %d\n", omp_get_num_threads()); }
+// Find the distance from source to the --target vertex with Bidirectional
+template <typename eidType>
+int run_point_to_point(std::string &path, vidType source, bool check,
+                       const Config &config) {
+  double t_start = omp_get_wtime();
+  Graph<eidType> *graph = load_graph<eidType>(path, config);
+  Bidirectional<eidType> *bfs = new Bidirectional<eidType>(graph);
+  double t_end = omp_get_wtime();
+
+  printf("Initialization: %f\n", t_end - t_start);
+  page_report(stdout);
+  if ((uint64_t)config.target >= graph->N) {
+    printf("Target %ld out of range\n", config.target);
+    delete bfs;
+    delete graph;
+    return 1;
+  }
+  source = graph->internal_id(source);
+  vidType target = graph->internal_id(config.target);
+
+  t_start = omp_get_wtime();
+  weight_type distance = bfs->distance(source, target);
+  t_end = omp_get_wtime();
+
+  printf("Runtime: %f\n", t_end - t_start);
+  printf("Distance: %u\n", distance);
+
+  bool correct = true;
+  if (check) {
+    Reference<eidType> reference(graph, false);
+    weight_type *distances = large_new<weight_type>(graph->N);
+    std::fill_n(distances, graph->N, std::numeric_limits<weight_type>::max());
+    reference.BFS(source, distances);
+    if (distances[target] != distance) {
+      printf("Incorrect distance, expected %u\n", distances[target]);
+      correct = false;
+    }
+    large_delete(distances);
+  }
+  delete bfs;
+  delete graph;
+  return correct ? 0 : 1;
+}
+
+// Load the graph with eidType edge indices, then run and time the BFS
+template <typename eidType>
+int run(std::string &path, std::string &algo_str, vidType source, bool check,
+        const Config &config) {
+  if (config.benchmark) {
+    BenchmarkConfig bench = config.bench;
+    bench.check = check;
+    Graph<eidType> *graph = load_graph<eidType>(path, config);
+    int ret = run_benchmark<eidType>(
+        graph,
+        [&config](Graph<eidType> *graph, const std::string &name) {
+          return make_engine(graph, name, config);
+        },
+        bench);
+    delete graph;
+    return ret;
+  }
+
+  if (config.target >= 0) {
+    return run_point_to_point<eidType>(path, source, check, config);
   }
+  if (config.serve) {
+    double t_start = omp_get_wtime();
+    Sparse<eidType> *bfs = static_cast<Sparse<eidType> *>(
+        make_engine(load_graph<eidType>(path, config), "sparse", config));
+    printf("Initialization: %f\n", omp_get_wtime() - t_start);
+    int ret = run_server(bfs, config.socket);
+    delete bfs;
+    return ret;
+  }
+
   double t_start = omp_get_wtime();
-  BFS_Impl *bfs = initialize_BFS(std::string(argv[1]), std::string(argv[3]));
+  BFS_Impl<eidType> *bfs =
+      initialize_BFS<eidType>(path, algo_str, config);
   double t_end = omp_get_wtime();
 
   printf("Initialization: %f\n", t_end - t_start);
+  page_report(stdout);
+
+  if (config.calibrate) {
+    std::vector<vidType> sources;
+    for (vidType s : bfs->graph->sources) {
+      sources.push_back(bfs->graph->internal_id(s));
+    }
+    if (sources.empty()) {
+      sources = random_sources(bfs->graph, CALIBRATE_SOURCES, 1);
+    }
+    calibrate_thresholds(bfs, config.schema_path, sources);
+  }
 
-  weight_type *result = new weight_type[bfs->graph->N];
+  MultiSource<eidType> *multi_source =
+      dynamic_cast<MultiSource<eidType> *>(bfs);
+  if (multi_source != nullptr) {
+    return run_multi_source(multi_source, source, check);
+  }
+
+  weight_type *result = large_new<weight_type>(bfs->graph->N);
   // Initialize result vector
   std::fill_n(result, bfs->graph->N, std::numeric_limits<weight_type>::max());
+  source = bfs->graph->internal_id(source);
 
   t_start = omp_get_wtime();
   bfs->BFS(source, result);
@@ -75,7 +445,98 @@ int main(const int argc, char **argv) {
 
   printf("Runtime: %f\n", t_end - t_start);
 
-  if (check) {
-    bfs->check_result(source, result);
+  bool correct = !check || bfs->check_result(source, result);
+  if (!config.output.empty()) {
+    // Parents are vertex IDs, so they are relabeled as well as permuted
+    bool parents = dynamic_cast<MergedCSR_Parents<eidType> *>(bfs) != nullptr;
+    bfs->graph->restore_order(result, parents);
+    std::ofstream out(config.output);
+    for (uint64_t v = 0; v < bfs->graph->N; v++) {
+      out << result[v] << "\n";
+    }
   }
-}
\ No newline at end of file
+  large_delete(result);
+  return correct ? 0 : 1;
+}
+
+int main(const int argc, char **argv) {
+  Options options;
+  std::vector<std::string> args = parse_args(argc, argv, options);
+  if (args.size() < 1 || args.size() > 4) {
+    printf(USAGE OPTIONS_USAGE, argv[0]);
+    return 1;
+  }
+  vidType source = 0;
+  std::string algo_str = "heuristic";
+  bool check = false;
+  Config config;
+  try {
+    config = parse_config(options);
+  } catch (const std::invalid_argument &e) {
+    printf("%s\n", e.what());
+    printf(USAGE OPTIONS_USAGE, argv[0]);
+    return 1;
+  }
+
+  if (args.size() > 1) {
+    source = std::stoi(args[1]);
+  }
+  if (args.size() > 2) {
+    algo_str = args[2];
+  }
+  if (args.size() > 3) {
+    if (args[3] == "true") {
+      check = true;
+    }
+  }
+
+#ifdef BFS_MPI
+  // Every rank runs the same commands (the distributed engine loads only the
+  // rows of its rank), only rank 0 prints and writes files
+  int provided, rank;
+  MPI_Init_thread(nullptr, nullptr, MPI_THREAD_FUNNELED, &provided);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (rank != 0) {
+    if (freopen("/dev/null", "w", stdout) == nullptr) {
+      return 1;
+    }
+    config.output.clear();
+    config.bench.report.clear();
+    config.perf.clear();
+    config.trace.clear();
+  }
+#endif
+
+#pragma omp parallel
+  {
+#pragma omp master
+    { printf("Number of threads: %d\n", omp_get_num_threads()); }
+  }
+  if (config.numa != NUMA_OFF) {
+    // Pin the threads before anything is allocated
+    printf("NUMA nodes: %d\n", numa_setup(config.numa));
+  }
+  set_page_mode(config.pages);
+  std::string path = "schemas/" + args[0];
+  config.schema_path = path;
+  bool wide_index = config.index == "64" ||
+                    (config.index == "auto" && needs_64bit_index(path));
+  printf("Edge index width: %d bits\n", wide_index ? 64 : 32);
+  int ret = wide_index ? run<uint64_t>(path, algo_str, source, check, config)
+                       : run<uint32_t>(path, algo_str, source, check, config);
+#ifdef BFS_PERF
+  PerfCounters::instance().report(stdout);
+  if (!config.perf.empty()) {
+    PerfCounters::instance().write_csv(config.perf);
+  }
+#endif
+#ifdef BFS_TRACE
+  if (!config.trace.empty()) {
+    Trace::instance().write(config.trace);
+  }
+#endif
+#ifdef BFS_MPI
+  MPI_Finalize();
+#endif
+  return ret;
+}
@@ -0,0 +1,154 @@
+#include "merged_cache.hpp"
+#include "graph.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char MERGED_CACHE_MAGIC[8] = "MERGCSR";
+
+// Reordered graphs get their own cache, tagged with the ordering
+template <typename eidType>
+static std::string cache_path(const Graph<eidType> *graph,
+                              MergedVariant variant) {
+  std::string path =
+      graph->dataset_path +
+      (variant == MERGED_PARENTS ? ".merged_csr_parents" : ".merged_csr") +
+      std::to_string(8 * sizeof(eidType));
+  if (graph->ordering != ORDER_NONE) {
+    path += std::string(".") + ordering_name(graph->ordering);
+  }
+  return path;
+}
+
+// Order-independent checksum, so it can be computed with a parallel reduction.
+// Each word is mixed with its position before being added
+template <typename eidType>
+static uint64_t checksum(const eidType *data, uint64_t size, uint64_t start) {
+  uint64_t sum = 0;
+#pragma omp parallel for reduction(+ : sum) schedule(static)
+  for (uint64_t i = 0; i < size; i++) {
+    uint64_t x = (uint64_t)data[i] ^ ((start + i) * 0x9E3779B97F4A7C15ULL);
+    x ^= x >> 31;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 29;
+    sum += x;
+  }
+  return sum;
+}
+
+template <typename eidType>
+static uint64_t checksum(const eidType *merged_rowptr,
+                         const eidType *merged_csr, uint64_t N,
+                         uint64_t merged_size) {
+  return checksum(merged_rowptr, N + 1, 0) +
+         checksum(merged_csr, merged_size, N + 1);
+}
+
+template <typename eidType> MergedCache<eidType>::~MergedCache() {
+  if (mapping != nullptr) {
+    munmap(mapping, mapping_size);
+  }
+}
+
+template <typename eidType>
+bool MergedCache<eidType>::load(const Graph<eidType> *graph,
+                                MergedVariant variant, eidType *&merged_rowptr,
+                                eidType *&merged_csr) {
+  if (graph->dataset_path.empty()) {
+    return false;
+  }
+  std::string path = cache_path(graph, variant);
+  struct stat cache_stat, dataset_stat;
+  if (stat(path.c_str(), &cache_stat) != 0 ||
+      stat(graph->dataset_path.c_str(), &dataset_stat) != 0 ||
+      cache_stat.st_mtime < dataset_stat.st_mtime) {
+    return false;
+  }
+  uint64_t merged_size = graph->M + variant * graph->N;
+  size_t expected_size = sizeof(MergedCacheHeader) +
+                         sizeof(eidType) * (graph->N + 1 + merged_size);
+  if ((size_t)cache_stat.st_size != expected_size) {
+    printf("Ignoring MergedCSR cache %s: unexpected size\n", path.c_str());
+    return false;
+  }
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  void *file = mmap(nullptr, expected_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (file == MAP_FAILED) {
+    return false;
+  }
+
+  const MergedCacheHeader *header = static_cast<MergedCacheHeader *>(file);
+  eidType *rowptr = reinterpret_cast<eidType *>(
+      static_cast<char *>(file) + sizeof(MergedCacheHeader));
+  eidType *csr = rowptr + graph->N + 1;
+  if (memcmp(header->magic, MERGED_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != MERGED_CACHE_VERSION ||
+      header->variant != variant || header->index_bytes != sizeof(eidType) ||
+      header->N != graph->N || header->M != graph->M ||
+      header->checksum != checksum(rowptr, csr, graph->N, merged_size)) {
+    printf("Ignoring MergedCSR cache %s: header or checksum mismatch\n",
+           path.c_str());
+    munmap(file, expected_size);
+    return false;
+  }
+  mapping = file;
+  mapping_size = expected_size;
+  merged_rowptr = rowptr;
+  merged_csr = csr;
+  return true;
+}
+
+template <typename eidType>
+void MergedCache<eidType>::store(const Graph<eidType> *graph,
+                                 MergedVariant variant,
+                                 const eidType *merged_rowptr,
+                                 const eidType *merged_csr) {
+  if (graph->dataset_path.empty()) {
+    return;
+  }
+  uint64_t merged_size = graph->M + variant * graph->N;
+  MergedCacheHeader header = {};
+  memcpy(header.magic, MERGED_CACHE_MAGIC, sizeof(header.magic));
+  header.version = MERGED_CACHE_VERSION;
+  header.variant = variant;
+  header.index_bytes = sizeof(eidType);
+  header.N = graph->N;
+  header.M = graph->M;
+  header.checksum = checksum(merged_rowptr, merged_csr, graph->N, merged_size);
+
+  // Write to a temporary file first, so that concurrent runs never map a
+  // partially written cache. mkstemp gives every writer (e.g. MPI ranks) its
+  // own file, so that the renamed cache is never interleaved
+  std::string path = cache_path(graph, variant);
+  std::string tmp_path = path + ".XXXXXX";
+  int fd = mkstemp(tmp_path.data());
+  if (fd == -1) {
+    printf("Warning: unable to write MergedCSR cache %s\n", path.c_str());
+    return;
+  }
+  // mkstemp creates the file readable only by its owner
+  fchmod(fd, 0644);
+  close(fd);
+  std::ofstream s{tmp_path, s.out | s.binary | s.trunc};
+  s.write((const char *)&header, sizeof(header));
+  s.write((const char *)merged_rowptr, sizeof(eidType) * (graph->N + 1));
+  s.write((const char *)merged_csr, sizeof(eidType) * merged_size);
+  s.close();
+  if (!s || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    printf("Warning: unable to write MergedCSR cache %s\n", path.c_str());
+    unlink(tmp_path.c_str());
+  }
+}
+
+template class MergedCache<uint32_t>;
+template class MergedCache<uint64_t>;
@@ -0,0 +1,135 @@
+#include "numa_placement.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <omp.h>
+#include <sched.h>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+// Nodes are tracked in a 64-bit mask
+#define MAX_NODES 64
+
+static NumaMode placement = NUMA_OFF;
+static std::vector<int> thread_node; // Node each OpenMP thread is pinned to
+static uint64_t node_mask = 0;       // Nodes used by the threads
+
+// Parse a sysfs list such as "0-3,8,10-11"
+static std::vector<int> parse_list(const std::string &list) {
+  std::vector<int> values;
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t end = list.find(',', pos);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    std::string range = list.substr(pos, end - pos);
+    size_t dash = range.find('-');
+    if (!range.empty()) {
+      int first = std::stoi(range.substr(0, dash));
+      int last = dash == std::string::npos ? first
+                                           : std::stoi(range.substr(dash + 1));
+      for (int v = first; v <= last; v++) {
+        values.push_back(v);
+      }
+    }
+    pos = end + 1;
+  }
+  return values;
+}
+
+static std::string read_line(const std::string &path) {
+  std::ifstream in(path);
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+
+static long mbind(void *addr, size_t len, int mode, const uint64_t *mask,
+                  unsigned long maxnode, unsigned flags) {
+  return syscall(SYS_mbind, addr, len, mode, mask, maxnode, flags);
+}
+
+int numa_setup(NumaMode mode) {
+  // CPUs of each node, restricted to the ones this process may run on
+  cpu_set_t allowed;
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+  std::vector<int> cpus, cpu_node;
+  std::vector<int> nodes =
+      parse_list(read_line("/sys/devices/system/node/online"));
+  for (int node : nodes) {
+    std::string path =
+        "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+    for (int cpu : parse_list(read_line(path))) {
+      if (node < MAX_NODES && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+        cpu_node.push_back(node);
+      }
+    }
+  }
+  if (cpus.empty()) {
+    printf("NUMA: topology not available, placement disabled\n");
+    return 1;
+  }
+
+  // Pin thread t to the t-th allowed CPU, so that the threads fill one node
+  // before moving to the next one
+  thread_node.assign(omp_get_max_threads(), 0);
+  node_mask = 0;
+#pragma omp parallel
+  {
+    int thread = omp_get_thread_num();
+    int slot = thread % cpus.size();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[slot], &set);
+    sched_setaffinity(0, sizeof(set), &set);
+    thread_node[thread] = cpu_node[slot];
+#pragma omp atomic
+    node_mask |= 1ULL << cpu_node[slot];
+  }
+  int num_nodes = __builtin_popcountll(node_mask);
+  if (num_nodes < 2 || mode == NUMA_OFF) {
+    if (mode != NUMA_OFF) {
+      printf("NUMA: single node, placement disabled\n");
+    }
+    placement = NUMA_OFF;
+    return num_nodes;
+  }
+  placement = mode;
+  return num_nodes;
+}
+
+void numa_place(void *ptr, size_t bytes) {
+  if (placement == NUMA_OFF) {
+    return;
+  }
+  // mbind works on whole pages: round the range inwards
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t begin = ((uintptr_t)ptr + page - 1) & ~(page - 1);
+  uintptr_t end = ((uintptr_t)ptr + bytes) & ~(page - 1);
+  if (end <= begin) {
+    return;
+  }
+  if (placement == NUMA_INTERLEAVE) {
+    mbind((void *)begin, end - begin, MPOL_INTERLEAVE, &node_mask,
+          MAX_NODES + 1, MPOL_MF_MOVE);
+    return;
+  }
+  // Same chunks as schedule(static), rounded to pages
+  uint64_t num_threads = thread_node.size();
+  uint64_t pages = (end - begin) / page;
+  for (uint64_t t = 0; t < num_threads; t++) {
+    uint64_t first = pages * t / num_threads;
+    uint64_t last = pages * (t + 1) / num_threads;
+    if (first == last) {
+      continue;
+    }
+    uint64_t mask = 1ULL << thread_node[t];
+    mbind((void *)(begin + first * page), (last - first) * page,
+          MPOL_PREFERRED, &mask, MAX_NODES + 1, MPOL_MF_MOVE);
+  }
+}
@@ -0,0 +1,153 @@
+#include "perf_counters.hpp"
+#include <cstring>
+#include <fstream>
+#include <linux/perf_event.h>
+#include <omp.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const char *event_names[PERF_NUM_EVENTS] = {
+    "cycles", "instructions", "llc_misses", "dtlb_misses", "stalls_backend"};
+
+static perf_event_attr event_attr(PerfEvent event) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  switch (event) {
+  case PERF_CYCLES:
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    break;
+  case PERF_INSTRUCTIONS:
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    break;
+  case PERF_LLC_MISSES:
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_LL |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    break;
+  case PERF_DTLB_MISSES:
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    break;
+  default:
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_STALLED_CYCLES_BACKEND;
+    break;
+  }
+  return attr;
+}
+
+PerfCounters &PerfCounters::instance() {
+  static PerfCounters counters;
+  return counters;
+}
+
+PerfCounters::~PerfCounters() {
+  for (int fd : fds) {
+    if (fd != -1) {
+      close(fd);
+    }
+  }
+}
+
+// Open the counters of every thread of the pool from the calling thread. The
+// counters follow their thread wherever it is scheduled
+void PerfCounters::open() {
+  opened = true;
+  std::vector<pid_t> tids(omp_get_max_threads());
+#pragma omp parallel
+  { tids[omp_get_thread_num()] = syscall(SYS_gettid); }
+
+  fds.assign(tids.size() * PERF_NUM_EVENTS, -1);
+  for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+    perf_event_attr attr = event_attr((PerfEvent)e);
+    available[e] = true;
+    for (size_t t = 0; t < tids.size(); t++) {
+      int fd = syscall(SYS_perf_event_open, &attr, tids[t], -1, -1, 0);
+      if (fd == -1) {
+        available[e] = false;
+        break;
+      }
+      fds[t * PERF_NUM_EVENTS + e] = fd;
+    }
+    if (!available[e]) {
+      fprintf(stderr, "Warning: perf event %s unavailable\n", event_names[e]);
+    }
+  }
+}
+
+void PerfCounters::read(uint64_t *values) {
+  if (!opened) {
+    open();
+  }
+  for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+    values[e] = 0;
+    if (!available[e]) {
+      continue;
+    }
+    for (size_t t = 0; t < fds.size() / PERF_NUM_EVENTS; t++) {
+      uint64_t value = 0;
+      if (::read(fds[t * PERF_NUM_EVENTS + e], &value, sizeof(value)) ==
+          sizeof(value)) {
+        values[e] += value;
+      }
+    }
+  }
+}
+
+void PerfCounters::add(const char *region, const uint64_t *start,
+                       const uint64_t *end) {
+  PerfTotals &totals = regions[region];
+  totals.calls++;
+  for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+    totals.values[e] += end[e] - start[e];
+  }
+}
+
+void PerfCounters::report(FILE *out) {
+  fprintf(out, "%-32s %8s", "Region", "calls");
+  for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+    fprintf(out, " %15s", event_names[e]);
+  }
+  fprintf(out, " %6s\n", "IPC");
+  for (const auto &[name, totals] : regions) {
+    fprintf(out, "%-32s %8lu", name.c_str(), totals.calls);
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+      if (available[e]) {
+        fprintf(out, " %15lu", totals.values[e]);
+      } else {
+        fprintf(out, " %15s", "n/a");
+      }
+    }
+    uint64_t cycles = totals.values[PERF_CYCLES];
+    fprintf(out, " %6.2f\n",
+            cycles ? (double)totals.values[PERF_INSTRUCTIONS] / cycles : 0.0);
+  }
+}
+
+void PerfCounters::write_csv(const std::string &path) {
+  std::ofstream out(path);
+  out << "region,calls";
+  for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+    out << "," << event_names[e];
+  }
+  out << "\n";
+  for (const auto &[name, totals] : regions) {
+    out << name << "," << totals.calls;
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+      out << ",";
+      if (available[e]) {
+        out << totals.values[e];
+      }
+    }
+    out << "\n";
+  }
+}
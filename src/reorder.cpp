@@ -0,0 +1,178 @@
+#include "graph.hpp"
+#include <algorithm>
+
+const char *ordering_name(Ordering ordering) {
+  switch (ordering) {
+  case ORDER_DEGREE:
+    return "degree";
+  case ORDER_RCM:
+    return "rcm";
+  case ORDER_BFS:
+    return "bfs";
+  default:
+    return "none";
+  }
+}
+
+#define DEGREE(v) (graph->rowptr[(v) + 1] - graph->rowptr[v])
+
+// Vertices by decreasing degree, ties broken by ID. Counting sort on the degree
+template <typename eidType>
+static std::vector<vidType> degree_order(const Graph<eidType> *graph) {
+  eidType max_degree = 0;
+#pragma omp parallel for reduction(max : max_degree) schedule(static)
+  for (vidType v = 0; v < graph->N; v++) {
+    max_degree = std::max(max_degree, DEGREE(v));
+  }
+  std::vector<uint64_t> offsets((uint64_t)max_degree + 2, 0);
+  for (vidType v = 0; v < graph->N; v++) {
+    offsets[max_degree - DEGREE(v) + 1]++;
+  }
+  for (uint64_t d = 1; d < offsets.size(); d++) {
+    offsets[d] += offsets[d - 1];
+  }
+  std::vector<vidType> order(graph->N);
+  for (vidType v = 0; v < graph->N; v++) {
+    order[offsets[max_degree - DEGREE(v)]++] = v;
+  }
+  return order;
+}
+
+// Visit order of BFSs started from each unvisited root in turn. If
+// sort_neighbors is set, the vertices discovered from the same vertex are
+// visited by increasing degree, as in Cuthill-McKee
+template <typename eidType>
+static std::vector<vidType> bfs_order(const Graph<eidType> *graph,
+                                      const std::vector<vidType> &roots,
+                                      bool sort_neighbors) {
+  std::vector<vidType> order;
+  order.reserve(graph->N);
+  std::vector<bool> visited(graph->N, false);
+  for (vidType root : roots) {
+    if (visited[root]) {
+      continue;
+    }
+    visited[root] = true;
+    order.push_back(root);
+    for (size_t head = order.size() - 1; head < order.size(); head++) {
+      vidType v = order[head];
+      size_t first = order.size();
+      for (eidType i = graph->rowptr[v]; i < graph->rowptr[v + 1]; i++) {
+        vidType neighbor = graph->col[i];
+        if (!visited[neighbor]) {
+          visited[neighbor] = true;
+          order.push_back(neighbor);
+        }
+      }
+      if (sort_neighbors) {
+        std::sort(order.begin() + first, order.end(),
+                  [graph](vidType a, vidType b) {
+                    return DEGREE(a) < DEGREE(b) ||
+                           (DEGREE(a) == DEGREE(b) && a < b);
+                  });
+      }
+    }
+  }
+  return order;
+}
+
+template <typename eidType> void Graph<eidType>::reorder(Ordering ordering) {
+  if (ordering == ORDER_NONE) {
+    return;
+  }
+  // order[i] is the vertex that gets ID i
+  std::vector<vidType> order = degree_order(this);
+  if (ordering == ORDER_RCM) {
+    // Start each component from a vertex of minimum degree
+    std::reverse(order.begin(), order.end());
+    order = bfs_order(this, order, true);
+    std::reverse(order.begin(), order.end());
+  } else if (ordering == ORDER_BFS) {
+    // Start each component from its hub, so it gets the smallest IDs
+    order = bfs_order(this, order, false);
+  }
+
+  eidType *new_rowptr = large_new<eidType>(N + 1);
+  vidType *new_col = large_new<vidType>(M);
+  std::vector<vidType> inverse(N);
+#pragma omp parallel for schedule(static)
+  for (vidType i = 0; i < N; i++) {
+    inverse[order[i]] = i;
+    new_rowptr[i + 1] = rowptr[order[i] + 1] - rowptr[order[i]];
+  }
+  new_rowptr[0] = 0;
+  for (vidType i = 0; i < N; i++) {
+    new_rowptr[i + 1] += new_rowptr[i];
+  }
+  // Weights follow their edges through the sort
+  wgtType *new_weights = weighted() ? large_new<wgtType>(M) : nullptr;
+#pragma omp parallel
+  {
+    std::vector<std::pair<vidType, wgtType>> row;
+#pragma omp for schedule(dynamic, 1024)
+    for (vidType i = 0; i < N; i++) {
+      eidType start = new_rowptr[i];
+      eidType offset = rowptr[order[i]];
+      eidType degree = new_rowptr[i + 1] - start;
+      if (new_weights == nullptr) {
+        for (eidType j = 0; j < degree; j++) {
+          new_col[start + j] = inverse[col[offset + j]];
+        }
+        std::sort(new_col + start, new_col + start + degree);
+        continue;
+      }
+      row.clear();
+      for (eidType j = 0; j < degree; j++) {
+        row.push_back({inverse[col[offset + j]], weights[offset + j]});
+      }
+      std::sort(row.begin(), row.end());
+      for (eidType j = 0; j < degree; j++) {
+        new_col[start + j] = row[j].first;
+        new_weights[start + j] = row[j].second;
+      }
+    }
+  }
+  release_storage();
+  rowptr = new_rowptr;
+  col = new_col;
+  weights = new_weights;
+
+  // Compose with a previous relabeling, if any
+  if (old_id.empty()) {
+    old_id = std::move(order);
+    new_id = std::move(inverse);
+  } else {
+#pragma omp parallel for schedule(static)
+    for (vidType i = 0; i < N; i++) {
+      order[i] = old_id[order[i]];
+    }
+    old_id = std::move(order);
+#pragma omp parallel for schedule(static)
+    for (vidType i = 0; i < N; i++) {
+      new_id[old_id[i]] = i;
+    }
+  }
+  this->ordering = ordering;
+}
+
+template <typename eidType>
+void Graph<eidType>::restore_order(weight_type *values,
+                                   bool vertex_values) const {
+  if (new_id.empty()) {
+    return;
+  }
+  std::vector<weight_type> current(values, values + N);
+#pragma omp parallel for schedule(static)
+  for (vidType v = 0; v < N; v++) {
+    weight_type value = current[new_id[v]];
+    if (vertex_values && value != (weight_type)-1) {
+      value = old_id[value];
+    }
+    values[v] = value;
+  }
+}
+
+template void Graph<uint32_t>::reorder(Ordering);
+template void Graph<uint64_t>::reorder(Ordering);
+template void Graph<uint32_t>::restore_order(weight_type *, bool) const;
+template void Graph<uint64_t>::restore_order(weight_type *, bool) const;
@@ -0,0 +1,171 @@
+#include "selector.hpp"
+#include "tuning.hpp"
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+#define DEGREE(v) (graph->rowptr[(v) + 1] - graph->rowptr[v])
+
+// Top-down BFS from source that gives up after max_levels levels, or before a
+// level that would take the edges scanned past max_edges. Returns the number
+// of levels run and one of the vertices of the last level, and sets exhausted
+// if the edge budget stopped it
+template <typename eidType>
+static uint32_t probe(const Graph<eidType> *graph, vidType source,
+                      uint32_t max_levels, uint64_t max_edges,
+                      vidType &farthest, bool &exhausted) {
+  std::unique_ptr<bool[]> visited(new bool[graph->N]);
+#pragma omp parallel for schedule(static)
+  for (vidType v = 0; v < graph->N; v++) {
+    visited[v] = false;
+  }
+  Frontier<vidType> this_frontier, next_frontier;
+  this_frontier.push_back(source);
+  visited[source] = true;
+  farthest = source;
+  uint32_t levels = 0;
+  uint64_t edges = 0;
+  exhausted = false;
+  while (!this_frontier.empty() && levels < max_levels) {
+    uint64_t frontier_edges = 0;
+#pragma omp parallel for reduction(+ : frontier_edges) schedule(static)       \
+    if (this_frontier.size() > 1000)
+    for (const auto &v : this_frontier) {
+      frontier_edges += DEGREE(v);
+    }
+    edges += frontier_edges;
+    if (edges > max_edges) {
+      exhausted = true;
+      break;
+    }
+    farthest = this_frontier[0];
+    next_frontier.clear();
+#pragma omp parallel if (this_frontier.size() > 50)
+    {
+      std::vector<vidType> &local_frontier = next_frontier.local();
+#pragma omp for schedule(dynamic, 64)
+      for (const auto &v : this_frontier) {
+        for (eidType i = graph->rowptr[v]; i < graph->rowptr[v + 1]; i++) {
+          vidType neighbor = graph->col[i];
+          if (!visited[neighbor] &&
+              !std::atomic_ref<bool>(visited[neighbor])
+                   .exchange(true, std::memory_order_relaxed)) {
+            local_frontier.push_back(neighbor);
+          }
+        }
+      }
+      next_frontier.flush();
+    }
+    std::swap(this_frontier, next_frontier);
+    levels++;
+  }
+  return levels;
+}
+
+template <typename eidType>
+static EngineChoice estimate(const Graph<eidType> *graph) {
+  EngineChoice choice = {};
+  double sum = 0, sum_squares = 0;
+  eidType max_degree = 0;
+  vidType hub = 0;
+#pragma omp parallel for reduction(+ : sum, sum_squares)                       \
+    reduction(max : max_degree) schedule(static)
+  for (vidType v = 0; v < graph->N; v++) {
+    double degree = DEGREE(v);
+    sum += degree;
+    sum_squares += degree * degree;
+    max_degree = std::max(max_degree, DEGREE(v));
+  }
+  for (vidType v = 0; v < graph->N; v++) {
+    if (DEGREE(v) == max_degree) {
+      hub = v;
+      break;
+    }
+  }
+  choice.avg_degree = sum / graph->N;
+  double variance =
+      sum_squares / graph->N - choice.avg_degree * choice.avg_degree;
+  choice.degree_cv =
+      choice.avg_degree > 0 ? std::sqrt(variance) / choice.avg_degree : 0;
+  choice.max_degree = max_degree;
+
+  // Double sweep: start from the hub, which is in the giant component, then
+  // from a vertex of the last level reached. The second probe only helps if
+  // the first one reached the end of the component
+  uint64_t max_edges = std::max<uint64_t>(
+      graph->M / SELECTOR_EDGE_FRACTION, SELECTOR_MIN_EDGES);
+  vidType farthest;
+  bool exhausted;
+  choice.levels =
+      probe(graph, hub, SELECTOR_MAX_LEVELS, max_edges, farthest, exhausted);
+  if (!exhausted && choice.levels < SELECTOR_MAX_LEVELS) {
+    choice.levels =
+        std::max(choice.levels, probe(graph, farthest, SELECTOR_MAX_LEVELS,
+                                      max_edges, farthest, exhausted));
+  }
+
+  char reason[128];
+  if (exhausted && choice.levels <= SELECTOR_SMALL_LEVELS) {
+    choice.engine = "bitmap";
+    snprintf(reason, sizeof(reason),
+             "frontier reached 1/%u of the edges in %u levels",
+             SELECTOR_EDGE_FRACTION, choice.levels);
+  } else if (choice.levels >= SELECTOR_MAX_LEVELS) {
+    choice.engine = "merged_csr";
+    snprintf(reason, sizeof(reason), "diameter >= %u", SELECTOR_MAX_LEVELS);
+  } else if (choice.levels <= SELECTOR_SMALL_LEVELS) {
+    choice.engine = "bitmap";
+    snprintf(reason, sizeof(reason), "diameter ~%u <= %u", choice.levels,
+             SELECTOR_SMALL_LEVELS);
+  } else if (choice.degree_cv > SELECTOR_SKEW) {
+    choice.engine = "bitmap";
+    snprintf(reason, sizeof(reason), "diameter ~%u, skewed degrees",
+             choice.levels);
+  } else {
+    choice.engine = "merged_csr";
+    snprintf(reason, sizeof(reason), "diameter ~%u, uniform degrees",
+             choice.levels);
+  }
+  choice.reason = reason;
+  return choice;
+}
+
+template <typename eidType>
+EngineChoice select_engine(const Graph<eidType> *graph,
+                           const std::string &schema_path, bool use_cache) {
+  EngineChoice choice = {};
+  nlohmann::json entry = use_cache ? read_tuning(schema_path, "selector",
+                                                 graph->N, graph->M)
+                                   : nullptr;
+  if (entry.is_object()) {
+    choice.engine = entry.value("engine", "bitmap");
+    choice.reason = entry.value("reason", "");
+    choice.levels = entry.value("levels", 0);
+    choice.avg_degree = entry.value("avg_degree", 0.0);
+    choice.degree_cv = entry.value("degree_cv", 0.0);
+    choice.max_degree = entry.value("max_degree", 0);
+    choice.cached = true;
+  } else {
+    choice = estimate(graph);
+    if (use_cache) {
+      write_tuning(schema_path, "selector",
+                   {{"engine", choice.engine},
+                    {"reason", choice.reason},
+                    {"levels", choice.levels},
+                    {"avg_degree", choice.avg_degree},
+                    {"degree_cv", choice.degree_cv},
+                    {"max_degree", choice.max_degree}},
+                   graph->N, graph->M);
+    }
+  }
+  printf("Selector: %s (%s; average degree %.2f, degree CV %.2f, max degree "
+         "%u)%s\n",
+         choice.engine.c_str(), choice.reason.c_str(), choice.avg_degree,
+         choice.degree_cv, choice.max_degree, choice.cached ? " [cached]" : "");
+  return choice;
+}
+
+template EngineChoice select_engine(const Graph<uint32_t> *,
+                                    const std::string &, bool);
+template EngineChoice select_engine(const Graph<uint64_t> *,
+                                    const std::string &, bool);
@@ -0,0 +1,141 @@
+#include "server.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <omp.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Run one query and stream the reached vertices. Only their state is reset
+// afterwards, so a query costs time proportional to what it reaches
+template <typename eidType>
+static void answer(Sparse<eidType> *bfs, vidType source, bool parents,
+                   FILE *out) {
+  const Graph<eidType> *graph = bfs->graph;
+  double t_start = omp_get_wtime();
+  bfs->query(graph->internal_id(source));
+  double t_end = omp_get_wtime();
+
+  const Frontier<vidType> &reached = bfs->visited();
+  fprintf(out, "%u %zu %f\n", source, reached.size(), t_end - t_start);
+  for (const auto &v : reached) {
+    weight_type value = parents ? graph->original_id(bfs->parent_of(v))
+                                : bfs->depth_of(v);
+    fprintf(out, "%u %u\n", graph->original_id(v), value);
+  }
+  bfs->reset();
+}
+
+// Parse a vertex ID of the dataset
+static bool parse_vertex(const std::string &word, uint64_t N, vidType &v) {
+  size_t parsed = 0;
+  uint64_t value = 0;
+  try {
+    value = std::stoull(word, &parsed);
+  } catch (const std::exception &) {
+  }
+  v = value;
+  return parsed == word.size() && value < N;
+}
+
+// Answer the queries read from in until the end of the input. Returns true if
+// a client asked the server to stop
+template <typename eidType>
+static bool serve(Sparse<eidType> *bfs, Bidirectional<eidType> *pair, FILE *in,
+                  FILE *out) {
+  const Graph<eidType> *graph = bfs->graph;
+  char *line = nullptr;
+  size_t capacity = 0;
+  bool quit = false;
+  while (!quit && getline(&line, &capacity, in) != -1) {
+    std::istringstream query(line);
+    std::string word, mode;
+    if (!(query >> word)) {
+      continue;
+    }
+    if (word == "quit") {
+      quit = true;
+      continue;
+    }
+    vidType source, target;
+    if (!parse_vertex(word, graph->N, source)) {
+      fprintf(out, "error invalid source %s\n", word.c_str());
+    } else if (!(query >> mode) || mode == "distances") {
+      answer(bfs, source, false, out);
+    } else if (mode == "parents") {
+      answer(bfs, source, true, out);
+    } else if (parse_vertex(mode, graph->N, target)) {
+      double t_start = omp_get_wtime();
+      weight_type distance = pair->distance(graph->internal_id(source),
+                                            graph->internal_id(target));
+      fprintf(out, "%u %u %u %f\n", source, target, distance,
+              omp_get_wtime() - t_start);
+    } else {
+      fprintf(out, "error invalid target or result %s\n", mode.c_str());
+    }
+    fflush(out);
+  }
+  free(line);
+  return quit;
+}
+
+static int listen_socket(const std::string &path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Error: socket path too long " + path);
+  }
+  strcpy(address.sun_path, path.c_str());
+  // Remove the socket left by a previous server
+  unlink(path.c_str());
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || bind(fd, (sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(fd, 16) != 0) {
+    throw std::runtime_error("Error: Unable to listen on socket " + path +
+                             ": " + strerror(errno));
+  }
+  return fd;
+}
+
+template <typename eidType>
+int run_server(Sparse<eidType> *bfs, const std::string &socket_path) {
+  Bidirectional<eidType> pair(bfs->graph);
+  if (socket_path.empty()) {
+    printf("Ready\n");
+    fflush(stdout);
+    serve(bfs, &pair, stdin, stdout);
+    return 0;
+  }
+
+  int server_fd = listen_socket(socket_path);
+  // A client that disconnects early must not stop the server
+  signal(SIGPIPE, SIG_IGN);
+  printf("Listening on %s\n", socket_path.c_str());
+  fflush(stdout);
+  bool quit = false;
+  while (!quit) {
+    int client_fd = accept(server_fd, nullptr, nullptr);
+    if (client_fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("Error: Unable to accept on socket " +
+                               socket_path + ": " + strerror(errno));
+    }
+    FILE *in = fdopen(client_fd, "r");
+    FILE *out = fdopen(dup(client_fd), "w");
+    quit = serve(bfs, &pair, in, out);
+    fclose(in);
+    fclose(out);
+  }
+  close(server_fd);
+  unlink(socket_path.c_str());
+  return 0;
+}
+
+template int run_server(Sparse<uint32_t> *, const std::string &);
+template int run_server(Sparse<uint64_t> *, const std::string &);
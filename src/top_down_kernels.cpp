@@ -0,0 +1,204 @@
+#include "top_down_kernels.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#define DEGREE(vertex) merged_csr[vertex]
+#define DISTANCE(vertex) merged_csr[(vertex) + 1]
+#define UNVISITED std::numeric_limits<uint32_t>::max()
+
+const char *simd_name(SimdLevel level) {
+  switch (level) {
+  case SIMD_AVX2:
+    return "avx2";
+  case SIMD_AVX512:
+    return "avx512";
+  default:
+    return "scalar";
+  }
+}
+
+SimdLevel parse_simd_level(const std::string &name) {
+  if (name == "scalar") {
+    return SIMD_SCALAR;
+  } else if (name == "avx2") {
+    return SIMD_AVX2;
+  } else if (name == "avx512") {
+    return SIMD_AVX512;
+  } else if (name == "auto") {
+    return detect_simd();
+  }
+  throw std::invalid_argument("Unknown SIMD level " + name);
+}
+
+SimdLevel detect_simd() {
+#ifdef X86_KERNELS
+  if (__builtin_cpu_supports("avx512f")) {
+    return SIMD_AVX512;
+  } else if (__builtin_cpu_supports("avx2")) {
+    return SIMD_AVX2;
+  }
+#endif
+  return SIMD_SCALAR;
+}
+
+template <typename eidType>
+static inline void discover(eidType *merged_csr, eidType neighbor,
+                            uint32_t distance, std::vector<eidType> &frontier,
+                            eidType &edges) {
+  // Vertices of degree 1 have no neighbor left to visit
+  if (DEGREE(neighbor) != 1) {
+    frontier.push_back(neighbor);
+    edges += DEGREE(neighbor);
+  }
+  DISTANCE(neighbor) = distance;
+}
+
+template <typename eidType>
+static eidType top_down_scalar(eidType *merged_csr, eidType begin, eidType end,
+                               uint32_t distance,
+                               std::vector<eidType> &frontier) {
+  eidType edges = 0;
+  for (eidType i = begin; i < end; i++) {
+    eidType neighbor = merged_csr[i];
+    if (DISTANCE(neighbor) == UNVISITED) {
+      discover(merged_csr, neighbor, distance, frontier, edges);
+    }
+  }
+  return edges;
+}
+
+#ifdef X86_KERNELS
+// AVX2 has no scatter nor compress-store, so the gather only filters the
+// visited neighbors, and the few unvisited ones are handled one by one. They
+// are checked again, as a neighbor may appear twice in the same vector
+__attribute__((target("avx2"))) static uint32_t
+top_down_avx2(uint32_t *merged_csr, uint32_t begin, uint32_t end,
+              uint32_t distance, std::vector<uint32_t> &frontier) {
+  uint32_t edges = 0;
+  const __m256i unvisited = _mm256_set1_epi32(-1);
+  const int *distances = (const int *)(merged_csr + 1);
+  uint32_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256i offsets = _mm256_loadu_si256((const __m256i *)(merged_csr + i));
+    __m256i gathered = _mm256_i32gather_epi32(distances, offsets, 4);
+    unsigned found = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(gathered, unvisited)));
+    while (found != 0) {
+      uint32_t neighbor = merged_csr[i + __builtin_ctz(found)];
+      found &= found - 1;
+      if (DISTANCE(neighbor) == UNVISITED) {
+        discover(merged_csr, neighbor, distance, frontier, edges);
+      }
+    }
+  }
+  return edges + top_down_scalar(merged_csr, i, end, distance, frontier);
+}
+
+__attribute__((target("avx2"))) static uint64_t
+top_down_avx2(uint64_t *merged_csr, uint64_t begin, uint64_t end,
+              uint32_t distance, std::vector<uint64_t> &frontier) {
+  uint64_t edges = 0;
+  const __m256i unvisited = _mm256_set1_epi64x(UNVISITED);
+  const long long *distances = (const long long *)(merged_csr + 1);
+  uint64_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m256i offsets = _mm256_loadu_si256((const __m256i *)(merged_csr + i));
+    __m256i gathered = _mm256_i64gather_epi64(distances, offsets, 8);
+    unsigned found = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(gathered, unvisited)));
+    while (found != 0) {
+      uint64_t neighbor = merged_csr[i + __builtin_ctz(found)];
+      found &= found - 1;
+      if (DISTANCE(neighbor) == UNVISITED) {
+        discover(merged_csr, neighbor, distance, frontier, edges);
+      }
+    }
+  }
+  return edges + top_down_scalar(merged_csr, i, end, distance, frontier);
+}
+
+// AVX-512 handles a whole vector at once: the unvisited neighbors get their
+// distance with a scatter, their degrees are gathered, and the ones of degree
+// other than 1 are compress-stored at the end of the frontier. A neighbor
+// appearing twice in the same vector is appended twice, as when two threads
+// discover it at once
+__attribute__((target("avx512f"))) static uint32_t
+top_down_avx512(uint32_t *merged_csr, uint32_t begin, uint32_t end,
+                uint32_t distance, std::vector<uint32_t> &frontier) {
+  uint32_t edges = 0;
+  const __m512i unvisited = _mm512_set1_epi32(-1);
+  const __m512i ones = _mm512_set1_epi32(1);
+  const __m512i level = _mm512_set1_epi32(distance);
+  uint32_t i = begin;
+  for (; i + 16 <= end; i += 16) {
+    __m512i offsets = _mm512_loadu_si512(merged_csr + i);
+    __m512i gathered = _mm512_i32gather_epi32(offsets, merged_csr + 1, 4);
+    __mmask16 found = _mm512_cmpeq_epi32_mask(gathered, unvisited);
+    if (found == 0) {
+      continue;
+    }
+    _mm512_mask_i32scatter_epi32(merged_csr + 1, found, offsets, level, 4);
+    __m512i degrees =
+        _mm512_mask_i32gather_epi32(ones, found, offsets, merged_csr, 4);
+    __mmask16 append = _mm512_mask_cmpneq_epi32_mask(found, degrees, ones);
+    edges += _mm512_mask_reduce_add_epi32(append, degrees);
+    size_t size = frontier.size();
+    frontier.resize(size + __builtin_popcount(append));
+    _mm512_mask_compressstoreu_epi32(frontier.data() + size, append, offsets);
+  }
+  return edges + top_down_scalar(merged_csr, i, end, distance, frontier);
+}
+
+__attribute__((target("avx512f"))) static uint64_t
+top_down_avx512(uint64_t *merged_csr, uint64_t begin, uint64_t end,
+                uint32_t distance, std::vector<uint64_t> &frontier) {
+  uint64_t edges = 0;
+  const __m512i unvisited = _mm512_set1_epi64(UNVISITED);
+  const __m512i ones = _mm512_set1_epi64(1);
+  const __m512i level = _mm512_set1_epi64(distance);
+  uint64_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m512i offsets = _mm512_loadu_si512(merged_csr + i);
+    __m512i gathered = _mm512_i64gather_epi64(offsets, merged_csr + 1, 8);
+    __mmask8 found = _mm512_cmpeq_epi64_mask(gathered, unvisited);
+    if (found == 0) {
+      continue;
+    }
+    _mm512_mask_i64scatter_epi64(merged_csr + 1, found, offsets, level, 8);
+    __m512i degrees =
+        _mm512_mask_i64gather_epi64(ones, found, offsets, merged_csr, 8);
+    __mmask8 append = _mm512_mask_cmpneq_epi64_mask(found, degrees, ones);
+    edges += _mm512_mask_reduce_add_epi64(append, degrees);
+    size_t size = frontier.size();
+    frontier.resize(size + __builtin_popcount(append));
+    _mm512_mask_compressstoreu_epi64(frontier.data() + size, append, offsets);
+  }
+  return edges + top_down_scalar(merged_csr, i, end, distance, frontier);
+}
+#endif
+
+template <typename eidType>
+TopDownKernel<eidType> top_down_kernel(SimdLevel &level, uint64_t words) {
+  level = std::min(level, detect_simd());
+  if (sizeof(eidType) == sizeof(uint32_t) &&
+      words > (uint64_t)std::numeric_limits<int32_t>::max()) {
+    level = SIMD_SCALAR;
+  }
+#ifdef X86_KERNELS
+  if (level == SIMD_AVX512) {
+    return top_down_avx512;
+  } else if (level == SIMD_AVX2) {
+    return top_down_avx2;
+  }
+#endif
+  level = SIMD_SCALAR;
+  return top_down_scalar<eidType>;
+}
+
+template TopDownKernel<uint32_t> top_down_kernel(SimdLevel &, uint64_t);
+template TopDownKernel<uint64_t> top_down_kernel(SimdLevel &, uint64_t);
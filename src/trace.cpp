@@ -0,0 +1,79 @@
+#include "trace.hpp"
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <omp.h>
+
+Trace &Trace::instance() {
+  static Trace trace;
+  return trace;
+}
+
+void Trace::begin_run(const char *engine, uint32_t source) {
+  runs.push_back({engine, source, {}});
+}
+
+void Trace::begin_level(int direction, uint64_t frontier_vertices,
+                        uint64_t frontier_edges, uint64_t unexplored_edges) {
+  runs.back().levels.push_back(
+      {direction, frontier_vertices, frontier_edges, unexplored_edges, 0});
+  level_start = omp_get_wtime();
+}
+
+void Trace::end_level() {
+  runs.back().levels.back().time = omp_get_wtime() - level_start;
+}
+
+static const char *direction_name(int direction) {
+  return direction == 0 ? "top_down" : "bottom_up";
+}
+
+void Trace::write(const std::string &path) const {
+  std::ofstream out(path);
+  if (!out.is_open()) {
+    printf("Warning: unable to write trace %s\n", path.c_str());
+    return;
+  }
+  bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+  if (csv) {
+    out << "run,engine,source,level,direction,frontier_vertices,"
+           "frontier_edges,unexplored_edges,time_s\n";
+    for (size_t r = 0; r < runs.size(); r++) {
+      for (size_t l = 0; l < runs[r].levels.size(); l++) {
+        const TraceLevel &level = runs[r].levels[l];
+        out << r << "," << runs[r].engine << "," << runs[r].source << "," << l
+            << "," << direction_name(level.direction) << ","
+            << level.frontier_vertices << ",";
+        if (level.frontier_edges != TRACE_UNKNOWN) {
+          out << level.frontier_edges;
+        }
+        out << ",";
+        if (level.unexplored_edges != TRACE_UNKNOWN) {
+          out << level.unexplored_edges;
+        }
+        out << "," << level.time << "\n";
+      }
+    }
+    return;
+  }
+  nlohmann::json trace = nlohmann::json::array();
+  for (const Run &run : runs) {
+    nlohmann::json levels = nlohmann::json::array();
+    for (const TraceLevel &level : run.levels) {
+      nlohmann::json entry = {{"direction", direction_name(level.direction)},
+                              {"frontier_vertices", level.frontier_vertices},
+                              {"time_s", level.time}};
+      entry["frontier_edges"] = nullptr;
+      if (level.frontier_edges != TRACE_UNKNOWN) {
+        entry["frontier_edges"] = level.frontier_edges;
+      }
+      entry["unexplored_edges"] = nullptr;
+      if (level.unexplored_edges != TRACE_UNKNOWN) {
+        entry["unexplored_edges"] = level.unexplored_edges;
+      }
+      levels.push_back(entry);
+    }
+    trace.push_back(
+        {{"engine", run.engine}, {"source", run.source}, {"levels", levels}});
+  }
+  out << trace.dump(2) << "\n";
+}
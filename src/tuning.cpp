@@ -0,0 +1,50 @@
+#include "tuning.hpp"
+#include <cstdio>
+#include <fstream>
+
+static std::string tuning_path(const std::string &schema_path) {
+  std::string path = schema_path;
+  size_t ext = path.rfind(".json");
+  if (ext != std::string::npos) {
+    path.erase(ext);
+  }
+  return path + ".tuning.json";
+}
+
+static nlohmann::json read_file(const std::string &path) {
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    return nlohmann::json::object();
+  }
+  nlohmann::json tuning = nlohmann::json::parse(in, nullptr, false);
+  if (!tuning.is_object()) {
+    printf("Ignoring malformed tuning file %s\n", path.c_str());
+    return nlohmann::json::object();
+  }
+  return tuning;
+}
+
+nlohmann::json read_tuning(const std::string &schema_path,
+                           const std::string &key, uint64_t N, uint64_t M) {
+  nlohmann::json tuning = read_file(tuning_path(schema_path));
+  auto it = tuning.find(key);
+  if (it == tuning.end() || !it->is_object() || it->value("N", 0ULL) != N ||
+      it->value("M", 0ULL) != M) {
+    return nullptr;
+  }
+  return *it;
+}
+
+void write_tuning(const std::string &schema_path, const std::string &key,
+                  nlohmann::json entry, uint64_t N, uint64_t M) {
+  std::string path = tuning_path(schema_path);
+  nlohmann::json tuning = read_file(path);
+  entry["N"] = N;
+  entry["M"] = M;
+  tuning[key] = entry;
+  std::ofstream out(path);
+  out << tuning.dump(2) << "\n";
+  if (!out) {
+    printf("Warning: unable to write tuning file %s\n", path.c_str());
+  }
+}
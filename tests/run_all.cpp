@@ -1,19 +1,27 @@
+#include "benchmark.hpp"
+#include "calibrate.hpp"
 #include "graph.hpp"
+#include "selector.hpp"
 #include <cstdint>
 #include <gtest/gtest.h>
 
-class BFSTest : public testing::Test {
+// Every test runs with both 32-bit and 64-bit edge indices
+template <typename eidType> class BFSTest : public testing::Test {
  protected:
   BFSTest() {
     chdir("../../");
     std::string schema_path = std::string("schemas/Collaboration_Network_1.json");
-    g = new Graph(schema_path);
+    g = new Graph<eidType>(schema_path);
   }
   
-  Graph *g;
+  Graph<eidType> *g;
 };
 
-void test_implementation(BFS_Impl *impl, uint32_t source) {
+using IndexTypes = testing::Types<uint32_t, uint64_t>;
+TYPED_TEST_SUITE(BFSTest, IndexTypes);
+
+template <typename eidType>
+void test_implementation(BFS_Impl<eidType> *impl, uint32_t source) {
   weight_type *result = new weight_type[impl->graph->N];
   std::fill_n(result, impl->graph->N, std::numeric_limits<weight_type>::max());
   impl->BFS(source, result);
@@ -22,27 +30,328 @@ void test_implementation(BFS_Impl *impl, uint32_t source) {
   EXPECT_TRUE(correct);
 }
 
-TEST_F(BFSTest, Bitmap) {
-  BFS_Impl *bitmap = new Bitmap(g);
+TYPED_TEST(BFSTest, Bitmap) {
+  BFS_Impl<TypeParam> *bitmap = new Bitmap<TypeParam>(this->g);
   test_implementation(bitmap, 5);
 }
 
-TEST_F(BFSTest, MergedCSR) {
-  BFS_Impl *merged_csr = new MergedCSR(g);
-  test_implementation(merged_csr, 5);
+TYPED_TEST(BFSTest, MergedCSR) {
+  MergedCSR<TypeParam> *merged_csr = new MergedCSR<TypeParam>(this->g);
+  EXPECT_EQ(merged_csr->simd_level(), detect_simd());
+  // Every top-down kernel the CPU supports
+  for (SimdLevel level : {SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512}) {
+    merged_csr->set_simd(level);
+    EXPECT_LE(merged_csr->simd_level(), level);
+    test_implementation(merged_csr, 5);
+  }
+}
+
+TYPED_TEST(BFSTest, MergedCSR_Compressed) {
+  MergedCSR_Compressed<TypeParam> *compressed =
+      new MergedCSR_Compressed<TypeParam>(this->g);
+  // Smaller than the MergedCSR layout, even with the 32-bit header
+  EXPECT_LT(compressed->bytes(),
+            sizeof(TypeParam) * (this->g->M + 2 * this->g->N));
+  test_implementation(compressed, 5);
 }
 
-TEST_F(BFSTest, MergedCSR_Parents) {
-  BFS_Impl *mergedCSR_Parents = new MergedCSR_Parents(g);
+TYPED_TEST(BFSTest, MergedCSR_Parents) {
+  BFS_Impl<TypeParam> *mergedCSR_Parents =
+      new MergedCSR_Parents<TypeParam>(this->g);
   test_implementation(mergedCSR_Parents, 5);
 }
 
-TEST_F(BFSTest, Classic) {
-  BFS_Impl *classic = new Classic(g);
+TYPED_TEST(BFSTest, Classic) {
+  BFS_Impl<TypeParam> *classic = new Classic<TypeParam>(this->g);
   test_implementation(classic, 5);
 }
 
-TEST_F(BFSTest, Reference) {
-  BFS_Impl *reference = new Reference(g);
+TYPED_TEST(BFSTest, Sparse) {
+  Sparse<TypeParam> *sparse = new Sparse<TypeParam>(this->g);
+  sparse->share_graph();
+  // Each query starts from the state reset after the previous one
+  for (vidType source : {5, 17, 5}) {
+    test_implementation(sparse, source);
+  }
+  sparse->query(5);
+  weight_type *parents = new weight_type[this->g->N];
+  std::fill_n(parents, this->g->N, std::numeric_limits<weight_type>::max());
+  for (const auto &v : sparse->visited()) {
+    parents[v] = sparse->parent_of(v);
+  }
+  EXPECT_TRUE(sparse->check_parents(5, parents));
+  delete[] parents;
+  delete sparse;
+}
+
+TYPED_TEST(BFSTest, Bidirectional) {
+  Graph<TypeParam> *g = this->g;
+  Bidirectional<TypeParam> bidirectional(g);
+  Reference<TypeParam> reference(g, false);
+  weight_type *distances = new weight_type[g->N];
+  for (vidType source : {5, 855708}) {
+    std::fill_n(distances, g->N, std::numeric_limits<weight_type>::max());
+    reference.BFS(source, distances);
+    for (vidType t = 0; t < 50; t++) {
+      vidType target = (t * 7919 + source) % g->N;
+      EXPECT_EQ(bidirectional.distance(source, target), distances[target]);
+    }
+  }
+  delete[] distances;
+}
+
+TYPED_TEST(BFSTest, Reference) {
+  BFS_Impl<TypeParam> *reference = new Reference<TypeParam>(this->g);
   test_implementation(reference, 5);
-}
\ No newline at end of file
+}
+
+TYPED_TEST(BFSTest, Validator) {
+  Graph<TypeParam> *g = this->g;
+  Reference<TypeParam> reference(g, false);
+  MergedCSR_Parents<TypeParam> merged_parents(g, false);
+  merged_parents.share_graph();
+  std::vector<weight_type> distances(g->N,
+                                    std::numeric_limits<weight_type>::max());
+  std::vector<weight_type> parents(g->N,
+                                  std::numeric_limits<weight_type>::max());
+  reference.BFS(5, distances.data());
+  merged_parents.BFS(5, parents.data());
+  ASSERT_TRUE(reference.check_distances(5, distances.data()));
+  ASSERT_TRUE(reference.check_parents(5, parents.data()));
+
+  // A reached vertex other than the source, with a parent other than it
+  vidType v = 0;
+  while (v == 5 || parents[v] == 5 ||
+         distances[v] == std::numeric_limits<weight_type>::max()) {
+    v++;
+  }
+  std::vector<weight_type> wrong = distances;
+  wrong[v]++;
+  EXPECT_FALSE(reference.check_distances(5, wrong.data()));
+  wrong[v] = std::numeric_limits<weight_type>::max();
+  EXPECT_FALSE(reference.check_distances(5, wrong.data()));
+  wrong = distances;
+  wrong[5] = 1;
+  EXPECT_FALSE(reference.check_distances(5, wrong.data()));
+
+  // A parent that is not a neighbor, and a cycle of parents
+  wrong = parents;
+  wrong[v] = v;
+  EXPECT_FALSE(reference.check_parents(5, wrong.data()));
+  wrong = parents;
+  wrong[parents[v]] = v;
+  EXPECT_FALSE(reference.check_parents(5, wrong.data()));
+}
+
+TYPED_TEST(BFSTest, MultiSource) {
+  Graph<TypeParam> *g = this->g;
+  MultiSource<TypeParam> *multi_source = new MultiSource<TypeParam>(g, 2);
+  std::vector<vidType> sources;
+  for (vidType s = 0; s < 100; s++) {
+    sources.push_back((s * 7919) % g->N);
+  }
+  std::vector<weight_type *> results(sources.size());
+  for (auto &result : results) {
+    result = new weight_type[g->N];
+    std::fill_n(result, g->N, std::numeric_limits<weight_type>::max());
+  }
+  multi_source->BFS(sources, results.data());
+  for (size_t s = 0; s < sources.size(); s++) {
+    EXPECT_TRUE(multi_source->check_result(sources[s], results[s]));
+    delete[] results[s];
+  }
+}
+
+TYPED_TEST(BFSTest, LoadModes) {
+  Graph<TypeParam> *g = this->g;
+  std::string schema_path = std::string("schemas/Collaboration_Network_1.json");
+  for (LoadMode mode : {LoadMode::READ, LoadMode::MMAP_POPULATE}) {
+    Graph<TypeParam> loaded(schema_path, mode);
+    ASSERT_EQ(loaded.N, g->N);
+    ASSERT_EQ(loaded.M, g->M);
+    EXPECT_TRUE(std::equal(g->rowptr, g->rowptr + g->N + 1, loaded.rowptr));
+    EXPECT_TRUE(std::equal(g->col, g->col + g->M, loaded.col));
+  }
+}
+
+TYPED_TEST(BFSTest, MergedCSRCache) {
+  // The first engine builds and stores the cache, the second one maps it
+  for (int run = 0; run < 2; run++) {
+    BFS_Impl<TypeParam> *merged_csr = new MergedCSR<TypeParam>(this->g, true);
+    test_implementation(merged_csr, 5);
+    BFS_Impl<TypeParam> *parents =
+        new MergedCSR_Parents<TypeParam>(this->g, true);
+    test_implementation(parents, 5);
+  }
+  std::string bits = std::to_string(8 * sizeof(TypeParam));
+  unlink((this->g->dataset_path + ".merged_csr" + bits).c_str());
+  unlink((this->g->dataset_path + ".merged_csr_parents" + bits).c_str());
+}
+
+TYPED_TEST(BFSTest, Reorder) {
+  Graph<TypeParam> *g = this->g;
+  std::string schema_path = std::string("schemas/Collaboration_Network_1.json");
+  Reference<TypeParam> original(g, false);
+  for (Ordering ordering : {ORDER_DEGREE, ORDER_RCM, ORDER_BFS}) {
+    Graph<TypeParam> *reordered = new Graph<TypeParam>(schema_path);
+    reordered->reorder(ordering);
+    ASSERT_EQ(reordered->M, g->M);
+    vidType source = reordered->internal_id(5);
+
+    // Distances and parents mapped back to the original IDs must be valid on
+    // the original graph
+    weight_type *distances = new weight_type[g->N];
+    std::fill_n(distances, g->N, std::numeric_limits<weight_type>::max());
+    Bitmap<TypeParam> bitmap(reordered);
+    bitmap.BFS(source, distances);
+    reordered->restore_order(distances, false);
+    EXPECT_TRUE(original.check_distances(5, distances));
+
+    weight_type *parents = new weight_type[g->N];
+    Graph<TypeParam> *reordered_parents = new Graph<TypeParam>(schema_path);
+    reordered_parents->reorder(ordering);
+    MergedCSR_Parents<TypeParam> merged(reordered_parents);
+    merged.BFS(source, parents);
+    reordered_parents->restore_order(parents, true);
+    EXPECT_TRUE(original.check_parents(5, parents));
+    delete[] distances;
+    delete[] parents;
+  }
+}
+
+TYPED_TEST(BFSTest, BuildCSR) {
+  // The edges of the dataset in reverse order give back its CSR
+  Graph<TypeParam> *g = this->g;
+  std::vector<int64_t> src(g->M), dst(g->M);
+  for (vidType v = 0; v < g->N; v++) {
+    for (TypeParam i = g->rowptr[v]; i < g->rowptr[v + 1]; i++) {
+      src[g->M - 1 - i] = v;
+      dst[g->M - 1 - i] = g->col[i];
+    }
+  }
+  Graph<TypeParam> rebuilt;
+  rebuilt.build_csr(src.data(), dst.data(), g->M, g->N);
+  ASSERT_EQ(rebuilt.N, g->N);
+  ASSERT_EQ(rebuilt.M, g->M);
+  for (vidType v = 0; v < g->N; v++) {
+    ASSERT_EQ(rebuilt.rowptr[v + 1], g->rowptr[v + 1]);
+    std::vector<vidType> row(g->col + g->rowptr[v], g->col + g->rowptr[v + 1]);
+    std::sort(row.begin(), row.end());
+    ASSERT_TRUE(std::equal(row.begin(), row.end(),
+                           rebuilt.col + rebuilt.rowptr[v]));
+  }
+
+  // Duplicates and self-loops
+  std::vector<int64_t> small_src = {3, 0, 1, 1, 2, 0, 3};
+  std::vector<int64_t> small_dst = {0, 1, 0, 1, 0, 1, 0};
+  Graph<TypeParam> small;
+  small.build_csr(small_src.data(), small_dst.data(), small_src.size(), 0,
+                  true, true);
+  std::vector<TypeParam> rowptr(small.rowptr, small.rowptr + small.N + 1);
+  std::vector<vidType> col(small.col, small.col + small.M);
+  EXPECT_EQ(rowptr, (std::vector<TypeParam>{0, 3, 4, 5, 6}));
+  EXPECT_EQ(col, (std::vector<vidType>{1, 2, 3, 0, 0, 0}));
+}
+
+TYPED_TEST(BFSTest, DeltaStepping) {
+  // The dataset with the same weight on both directions of each edge
+  Graph<TypeParam> *g = this->g;
+  std::vector<int64_t> src(g->M), dst(g->M);
+  std::vector<wgtType> edge_weights(g->M);
+  for (vidType v = 0; v < g->N; v++) {
+    for (TypeParam i = g->rowptr[v]; i < g->rowptr[v + 1]; i++) {
+      uint64_t low = std::min(v, g->col[i]), high = std::max(v, g->col[i]);
+      src[i] = v;
+      dst[i] = g->col[i];
+      edge_weights[i] = (low * 31 + high * 17) % 100 + 1;
+    }
+  }
+  Graph<TypeParam> weighted;
+  weighted.build_csr(src.data(), dst.data(), g->M, g->N, false, false,
+                     edge_weights.data());
+  ASSERT_TRUE(weighted.weighted());
+  DeltaStepping<TypeParam> *delta_stepping =
+      new DeltaStepping<TypeParam>(&weighted);
+  delta_stepping->share_graph();
+  EXPECT_GE(delta_stepping->delta, 1);
+  for (vidType source : {5, 855708}) {
+    test_implementation(delta_stepping, source);
+  }
+  delta_stepping->delta = 1;
+  test_implementation(delta_stepping, 5);
+  delete delta_stepping;
+  EXPECT_THROW(DeltaStepping<TypeParam> unweighted(g), std::runtime_error);
+
+  // Parallel edges keep the lightest weight
+  std::vector<int64_t> small_src = {0, 0, 1};
+  std::vector<int64_t> small_dst = {1, 1, 2};
+  std::vector<wgtType> small_weights = {7, 3, 5};
+  Graph<TypeParam> small;
+  small.build_csr(small_src.data(), small_dst.data(), small_src.size(), 0,
+                  true, false, small_weights.data());
+  std::vector<wgtType> weights(small.weights, small.weights + small.M);
+  EXPECT_EQ(weights, (std::vector<wgtType>{3, 3, 5, 5}));
+}
+
+TYPED_TEST(BFSTest, Benchmark) {
+  Graph<TypeParam> *g = this->g;
+  std::vector<vidType> sources = random_sources(g, 8, 1);
+  ASSERT_EQ(sources.size(), 8);
+  for (vidType s : sources) {
+    EXPECT_GT(g->rowptr[s + 1], g->rowptr[s]);
+  }
+
+  BenchmarkConfig config = {{"bitmap", "merged_csr"}, 2, 1, 2, 1, true, ""};
+  EngineFactory<TypeParam> make_engine =
+      [](Graph<TypeParam> *graph,
+         const std::string &name) -> BFS_Impl<TypeParam> * {
+    if (name == "bitmap") {
+      return new Bitmap<TypeParam>(graph);
+    }
+    return new MergedCSR<TypeParam>(graph);
+  };
+  EXPECT_EQ(run_benchmark(g, make_engine, config), 0);
+}
+
+TYPED_TEST(BFSTest, Selector) {
+  Graph<TypeParam> *g = this->g;
+  std::string schema_path = std::string("schemas/Collaboration_Network_1.json");
+  EngineChoice choice = select_engine(g, schema_path, true);
+  EXPECT_FALSE(choice.cached);
+  EXPECT_TRUE(choice.engine == "merged_csr" || choice.engine == "bitmap");
+  EXPECT_GT(choice.levels, 0);
+
+  // The second call reads the decision stored in the tuning file
+  EngineChoice cached = select_engine(g, schema_path, true);
+  EXPECT_TRUE(cached.cached);
+  EXPECT_EQ(cached.engine, choice.engine);
+  EXPECT_EQ(cached.levels, choice.levels);
+  unlink("schemas/Collaboration_Network_1.tuning.json");
+}
+
+TYPED_TEST(BFSTest, Thresholds) {
+  // Extreme thresholds force pure top-down or early bottom-up traversals
+  for (uint32_t alpha : {1u, 1000000u}) {
+    BFS_Impl<TypeParam> *engines[] = {new Bitmap<TypeParam>(this->g),
+                                      new MergedCSR<TypeParam>(this->g),
+                                      new Classic<TypeParam>(this->g)};
+    for (BFS_Impl<TypeParam> *engine : engines) {
+      engine->share_graph();
+      engine->alpha = alpha;
+      engine->beta = alpha;
+      test_implementation(engine, 5);
+      delete engine;
+    }
+  }
+
+  std::string schema_path = std::string("schemas/Collaboration_Network_1.json");
+  Bitmap<TypeParam> bitmap(this->g);
+  bitmap.share_graph();
+  calibrate_thresholds<TypeParam>(&bitmap, schema_path, {5});
+  Bitmap<TypeParam> tuned(this->g);
+  tuned.share_graph();
+  EXPECT_TRUE(load_thresholds<TypeParam>(&tuned, schema_path));
+  EXPECT_EQ(tuned.alpha, bitmap.alpha);
+  EXPECT_EQ(tuned.beta, bitmap.beta);
+  unlink("schemas/Collaboration_Network_1.tuning.json");
+}